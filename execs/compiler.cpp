@@ -7,11 +7,21 @@
  * - Performs syntax analysis on MiniC program, building as AST.
  * - Performs semantic analysis on AST.
  * - Exits if either syntax analysis or semantic analysis fails.
+ * - Optimizes the generated IR and emits assembly code.
+ * - Options select the optimization pipeline:
+ *   -O0, -O1, -O2 (default), -passes=<p1,p2;p3>, -max-iterations=<n>, -disable-pass=<p>, -enable-pass=<p>
+ * - Options bound optimization work: -opt-time-budget=<ms>, -opt-fuel=<instruction visits>
+ * - Options report optimization work: -opt-stats prints statistics, -opt-remarks=<file.yaml> records each transformation
+ * - Options select the register allocator: -regalloc=linear-scan (default) or -regalloc=graph-coloring; -regalloc-stats reports spills and copies
  *
  */
 
 #include <iostream>
+#include <charconv>
 #include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
 #include <ast.h>
 #include <semantic_analysis.h>
 #include <optimizer.h>
@@ -23,23 +33,122 @@ extern int yylex_destroy(void);
 extern FILE* yyin;
 extern astNode* root;
 
+/*
+ * Parses a whole string as a non-negative count.
+ *
+ * Args:
+ * - str: text of the count.
+ * - n: set to the count on success.
+ *
+ * Returns:
+ * - True on success, false if str is not a number or does not fit
+ */
+static bool parse_count(const std::string& str, size_t& n) {
+    std::from_chars_result res;
+
+    res = std::from_chars(str.data(), str.data() + str.size(), n);
+    return res.ec == std::errc() && res.ptr == str.data() + str.size();
+}
+
+/*
+ * Parses a whole string of digits with an optional decimal point as a number of milliseconds.
+ *
+ * Args:
+ * - str: text of the duration.
+ * - ms: set to the duration on success.
+ *
+ * Returns:
+ * - True on success, false if str is not such a number
+ */
+static bool parse_ms(const std::string& str, double& ms) {
+    std::from_chars_result res;
+
+    if (str.find_first_not_of("0123456789.") != std::string::npos) return false;
+
+    res = std::from_chars(str.data(), str.data() + str.size(), ms);
+    return res.ec == std::errc() && res.ptr == str.data() + str.size();
+}
+
+/*
+ * Applies the optimization options to an optimizer, in command-line order, and reads the code generation options.
+ *
+ * Args:
+ * - opt: optimizer to configure.
+ * - options: options beginning with '-'.
+ * - print_stats: set if statistics should be printed after optimizing.
+ * - remarks_file: set to the remarks file name, if any.
+ * - allocator: set to the register allocator to use.
+ * - print_alloc_stats: set if register allocation statistics should be printed.
+ *
+ * Returns:
+ * - True on success, false if an option is malformed or names an unknown pass
+ */
+static bool configure_optimizer(Optimizer& opt, const std::vector<std::string>& options, bool& print_stats, std::string& remarks_file, RegAllocator& allocator, bool& print_alloc_stats) {
+    std::vector<std::string>::const_iterator it;
+    size_t count;
+    double ms;
+    bool ok;
+
+    ok = true;
+    for (it = options.begin(); it != options.end() && ok; ++it) {
+        if (*it == "-O0" || *it == "-O1" || *it == "-O2") ok = opt.set_opt_level(it->at(2) - '0');
+        else if (it->starts_with("-passes=")) ok = opt.set_pipeline(it->substr(8));
+        else if (it->starts_with("-disable-pass=")) ok = opt.set_pass_enabled(it->substr(14), false);
+        else if (it->starts_with("-enable-pass=")) ok = opt.set_pass_enabled(it->substr(13), true);
+        else if (it->starts_with("-max-iterations=") && parse_count(it->substr(16), count))
+            opt.set_max_iterations(count);
+        else if (it->starts_with("-opt-fuel=") && parse_count(it->substr(10), count))
+            opt.set_fuel(count);
+        else if (it->starts_with("-opt-time-budget=") && parse_ms(it->substr(17), ms))
+            opt.set_time_budget(ms);
+        else if (*it == "-opt-stats") print_stats = true;
+        else if (it->starts_with("-opt-remarks=") && it->size() > 13) {
+            remarks_file = it->substr(13);
+            opt.enable_remarks(true);
+        }
+        else if (*it == "-regalloc=linear-scan") allocator = REGALLOC_LINEAR_SCAN;
+        else if (*it == "-regalloc=graph-coloring") allocator = REGALLOC_GRAPH_COLORING;
+        else if (*it == "-regalloc-stats") print_alloc_stats = true;
+        else {
+            std::cerr << "Unknown option " << *it << ".\n";
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
 int main(int argc, char** argv) {
-    int ret;
+    int ret, k;
     Optimizer opt;
     IRGen ir;
     LLVMModuleRef m;
     std::string ofile;
+    std::vector<std::string> options, files;
+    std::map<std::string, size_t>::const_iterator skip_it, stat_it;
+    std::string remarks_file;
+    bool print_stats, print_alloc_stats;
+    RegAllocator allocator;
+    RegAllocStats alloc_stats;
+
+    for (k = 1; k < argc; k++) {
+        if (argv[k][0] == '-') options.push_back(argv[k]);
+        else files.push_back(argv[k]);
+    }
 
     // Check arguments.
-    if (argc != 3) {
-        std::cout << "usage: ./compiler <in_file.c> <out_file.s>\n";
+    if (files.size() != 2) {
+        std::cout << "usage: ./compiler [-O0|-O1|-O2] [-passes=<p1,p2;p3>] [-max-iterations=<n>] [-disable-pass=<p>] [-enable-pass=<p>] [-opt-time-budget=<ms>] [-opt-fuel=<n>] [-opt-stats] [-opt-remarks=<file.yaml>] [-regalloc=linear-scan|graph-coloring] [-regalloc-stats] <in_file.c> <out_file.s>\n";
         return 1;
     }
 
-    ofile = std::string(argv[2]);
+    ofile = files[1];
+    print_stats = false;
+    print_alloc_stats = false;
+    allocator = REGALLOC_LINEAR_SCAN;
 
     // Open file.
-    if ((yyin = fopen(argv[1], "r")) == NULL) {
+    if ((yyin = fopen(files[0].c_str(), "r")) == NULL) {
         std::cerr << "Failed to open file.\n";
         return 1;
     }
@@ -64,13 +173,41 @@ int main(int argc, char** argv) {
 
     opt = Optimizer(m);
 
+    if (!configure_optimizer(opt, options, print_stats, remarks_file, allocator, print_alloc_stats)) return 1;
+
+    if (opt.optimize() == -1) {
+        std::cerr << "Optimization failed.\n";
+        return 1;
+    }
+
+    // The module is valid but less optimized; say what was left out.
+    if (opt.budget_exhausted()) {
+        std::cerr << "Optimization budget exhausted; skipped pass runs:";
+        for (skip_it = opt.get_skipped_passes().begin(); skip_it != opt.get_skipped_passes().end(); ++skip_it)
+            std::cerr << " " << skip_it->first << " x" << skip_it->second;
+        std::cerr << "\n";
+    }
+
+    if (print_stats)
+        for (stat_it = opt.get_statistics().begin(); stat_it != opt.get_statistics().end(); ++stat_it)
+            std::cerr << stat_it->first << ": " << stat_it->second << "\n";
+
+    if (!remarks_file.empty() && !opt.write_remarks(remarks_file)) return 1;
+
     m = opt.get_module_ref();
 
-    if (code_gen(m, ofile) != 0) {
+    if (code_gen(m, ofile, allocator, &alloc_stats) != 0) {
         std::cerr << "Code gen failed.\n";
         return 1;
     }
 
+    if (print_alloc_stats) {
+        std::cerr << "regalloc.values: " << alloc_stats.values << "\n";
+        std::cerr << "regalloc.spilled: " << alloc_stats.spilled << "\n";
+        std::cerr << "regalloc.copies: " << alloc_stats.copies << "\n";
+        std::cerr << "regalloc.copies_eliminated: " << alloc_stats.copies_eliminated << "\n";
+    }
+
     // Clean up.
     freeNode(root);
     fclose(yyin);
@@ -0,0 +1,34 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+    int a;
+    int b;
+    int c;
+    int d;
+    int i;
+    int s;
+    int t;
+
+    a = 1;
+    b = 2;
+    c = 3;
+    d = 4;
+    s = 0;
+    i = 0;
+
+    while (i < n){
+        t = a * b;
+        s = s + t;
+        a = a + c;
+        b = b + d;
+        c = c + 1;
+        d = d - 1;
+        i = i + 1;
+    }
+
+    t = s + a;
+    t = t + b;
+    t = t + c;
+    return t + d;
+}
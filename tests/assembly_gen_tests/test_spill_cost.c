@@ -0,0 +1,38 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+    int a;
+    int b;
+    int c;
+    int i;
+    int s;
+    int t;
+    int u;
+    int v;
+    int w;
+
+    u = n + 7;
+    v = n * 3;
+    w = n - 2;
+    a = 1;
+    b = 2;
+    c = 3;
+    s = 0;
+    i = 0;
+
+    while (i < n){
+        t = a * b;
+        s = s + t;
+        a = a + c;
+        b = b + 1;
+        c = c + 2;
+        i = i + 1;
+    }
+
+    t = s + u;
+    t = t + v;
+    t = t + w;
+    t = t + a;
+    return t + b;
+}
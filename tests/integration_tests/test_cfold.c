@@ -0,0 +1,14 @@
+extern void print(int);
+extern int read();
+
+int func(void) {
+    int a;
+    int b;
+    int c1;
+    int c2;
+    a = 10;
+    b = 20;
+    c2 = a < b;
+
+    return c2;
+}
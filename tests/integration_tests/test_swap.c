@@ -0,0 +1,24 @@
+extern void print(int);
+extern int read(void);
+
+int func(int n) {
+    int a;
+    int b;
+    int t;
+    int i;
+
+    a = 1;
+    b = 2;
+    i = 0;
+
+    while (i < n) {
+        t = a;
+        a = b;
+        b = t;
+        i = i + 1;
+    }
+
+    t = a * 10;
+
+    return t + b;
+}
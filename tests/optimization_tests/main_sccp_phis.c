@@ -0,0 +1,28 @@
+#include <stdio.h>
+
+int func(int);
+
+int printed[4];
+int num_printed = 0;
+
+int read(void) {
+    int x;
+    scanf("%d", &x); 
+    return x;
+}
+
+void print(int x) {
+    printf("%d\n", x);
+    if (num_printed < 4)
+        printed[num_printed] = x;
+    num_printed++;
+}
+
+int main(void) {
+    int i = func(5);
+    printf("%d\n", i);
+    if (i == -27 && num_printed == 4 && printed[0] == -26 && printed[1] == -36 && printed[2] == 0 && printed[3] == -1)
+        return 0;
+    else
+        return 1;
+}
@@ -0,0 +1,28 @@
+#include <stdio.h>
+
+int func(int);
+
+int printed[4];
+int num_printed = 0;
+
+int read(void) {
+    int x;
+    scanf("%d", &x); 
+    return x;
+}
+
+void print(int x) {
+    printf("%d\n", x);
+    if (num_printed < 4)
+        printed[num_printed] = x;
+    num_printed++;
+}
+
+int main(void) {
+    int i = func(5);
+    printf("%d\n", i);
+    if (i == 284901888 && num_printed == 4 && printed[0] == 0 && printed[1] == -2100000000 && printed[2] == 94967296 && printed[3] == -2005032704)
+        return 0;
+    else
+        return 1;
+}
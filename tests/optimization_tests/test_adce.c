@@ -0,0 +1,30 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int s;
+	int w;
+	int i;
+	int j;
+
+	s = 0;
+	w = 1;
+	i = 0;
+	while (i < n) {
+		if (i < 2) {
+			w = w * 3;
+		}
+		else {
+			w = w + i;
+		}
+		s = s + i;
+		i = i + 1;
+	}
+	j = 0;
+	while (j < n) {
+		w = w + j;
+		j = j + 1;
+	}
+	print(s);
+	return s * 4;
+}
@@ -0,0 +1,26 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int i;
+	int s;
+	int c;
+	int k;
+
+	i = 0;
+	s = 0;
+	c = 0;
+	k = n;
+	while (i < n) {
+		s = s + i;
+		c = c + 3;
+		i = i + 1;
+	}
+	while (k > 0) {
+		k = k - 1;
+	}
+	s = s + c;
+	s = s + k;
+	print(s);
+	return s;
+}
@@ -0,0 +1,21 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+	int unused;
+	int i;
+
+	a = 1;
+	unused = n;
+	a = n + 2;
+	i = 0;
+	while (i < n) {
+		unused = unused + i;
+		a = a + a;
+		i = i + 1;
+	}
+	unused = 4;
+	print(a);
+	return a;
+}
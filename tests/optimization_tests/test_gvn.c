@@ -0,0 +1,25 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+	int b;
+	int c;
+	int i;
+
+	a = n * 3;
+	i = 0;
+	c = 0;
+	if (n > 2) {
+		b = n * 3;
+		c = b + a;
+		if (n > 2) c = c + 1;
+	}
+	while (i < n) {
+		b = n * 3;
+		c = c + b;
+		i = i + 1;
+	}
+	print(c);
+	return c;
+}
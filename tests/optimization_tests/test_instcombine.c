@@ -0,0 +1,23 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+	int b;
+	int c;
+
+	a = n * 1;
+	a = a + 0;
+	b = -a;
+	b = -b;
+	c = b - a;
+	c = c + n;
+	c = c * 8;
+	a = a - 3;
+	a = a - 4;
+	if (n == n) {
+		c = c + a;
+	}
+	print(c);
+	return c;
+}
@@ -0,0 +1,30 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+	int b;
+	int c;
+	int i;
+	int j;
+	int d;
+
+	a = n + 3;
+	i = 0;
+	c = 0;
+	while (i < n) {
+		d = a * 4;
+		b = d + n;
+		j = 0;
+		while (j < i) {
+			d = a * 4;
+			c = c + b;
+			c = c - d;
+			j = j + 1;
+		}
+		c = c + b;
+		i = i + 1;
+	}
+	print(c);
+	return c;
+}
@@ -0,0 +1,25 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+	int b;
+	int c;
+
+	a = 3;
+	b = -a;
+	if (a > 2) {
+		c = b * 2;
+	}
+	else {
+		c = n;
+	}
+	if (c == -6) {
+		c = c + n;
+	}
+	else {
+		c = c - 100;
+	}
+	print(c);
+	return c;
+}
@@ -0,0 +1,31 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+    int v0;
+    int v1;
+    int v2;
+    int v3;
+    int k;
+    int t;
+
+    k = 4;
+    v0 = n;
+    v1 = 0;
+    v2 = n + 1;
+    v3 = -1;
+    if (k > 2) {
+        v0 = -26;
+        v1 = 0;
+        v2 = 6;
+    }
+    t = v0;
+    print(v0);
+    v0 = -v2;
+    v0 = v0 * v2;
+    print(v0);
+    print(v1);
+    print(v3);
+    v3 = v3 + t;
+    return v3;
+}
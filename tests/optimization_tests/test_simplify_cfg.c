@@ -0,0 +1,24 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+
+	a = n;
+	if (n > 3) {
+		a = a + 1;
+	}
+	else {
+		if (n < 0) {
+			a = 0;
+		}
+		else {
+			a = a + 2;
+		}
+	}
+	while (a < 10) {
+		a = a + 2;
+	}
+	print(a);
+	return a;
+}
@@ -0,0 +1,20 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int i;
+	int s;
+	int t;
+
+	i = 0;
+	s = 0;
+	while (i < 10) {
+		t = i * 6;
+		s = s + t;
+		t = n * i;
+		s = s + t;
+		i = i + 1;
+	}
+	print(s);
+	return s;
+}
@@ -0,0 +1,18 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+    int i;
+    int s;
+    int t;
+
+    i = 0;
+    s = 0;
+    while (i < 5) {
+        t = i * 3;
+        s = s + t;
+        print(t);
+        i = i - 700000000;
+    }
+    return s;
+}
@@ -23,36 +23,39 @@ if [[ $# -eq 1 && $1 != "-v" ]] ; then
     exit 1
 fi
 
-for test in $TESTDIR/test*.c ; do
-    outfile=${test%.c}.s
-    $EXEC $test $outfile &> /dev/null
-
-    # Make sure assembly code was generated.
-    if [ $? -ne 0 ] ; then
-        echo "FAILED to build assembly code for: $test"
-        FAILED=1
-    fi
-done
-
-# Run all tests.
-pushd $TESTDIR
-make > /dev/null
-
-for exec in ./* ; do
-    if [ -x $exec ] ; then
-        ./$exec &> /dev/null
+# Every optimization level must give the same results.
+for level in -O0 -O1 -O2 ; do
+    for test in $TESTDIR/test*.c ; do
+        outfile=${test%.c}.s
+        $EXEC $level $test $outfile &> /dev/null
 
+        # Make sure assembly code was generated.
         if [ $? -ne 0 ] ; then
-            echo "FAIL: $exec"
+            echo "FAILED to build assembly code for: $test ($level)"
             FAILED=1
-        elif [ $# -eq 1 ] ; then
-            echo "PASS: $exec"
         fi
-    fi
-done
+    done
+
+    # Run all tests.
+    pushd $TESTDIR
+    make > /dev/null
 
-make clean > /dev/null
-popd
+    for exec in ./* ; do
+        if [ -x $exec ] ; then
+            ./$exec &> /dev/null
+
+            if [ $? -ne 0 ] ; then
+                echo "FAIL: $exec ($level)"
+                FAILED=1
+            elif [ $# -eq 1 ] ; then
+                echo "PASS: $exec ($level)"
+            fi
+        fi
+    done
+
+    make clean > /dev/null
+    popd
+done
 
 if [ $FAILED -ne 0 ] ; then
     exit 1
@@ -14,6 +14,7 @@ int main(int argc, char** argv) {
     std::string ifile;
     std::string ofile;
     Optimizer optimizer;
+    std::map<std::string, size_t>::const_iterator stat_it;
     int ret;
 
     // Check arguments.
@@ -35,6 +36,10 @@ int main(int argc, char** argv) {
     }
 
     if (ret != 0) std::cout << ret << " unassigned variable(s).\n";
+    std::cout << optimizer.get_dataflow_visits() << " dataflow block visit(s).\n";
+    std::cout << optimizer.get_analysis_reuses() << " cached analysis reuse(s).\n";
+    for (stat_it = optimizer.get_statistics().begin(); stat_it != optimizer.get_statistics().end(); ++stat_it)
+        std::cout << stat_it->first << ": " << stat_it->second << "\n";
 
     optimizer.write_to_file(ofile);
 
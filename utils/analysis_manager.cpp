@@ -0,0 +1,1034 @@
+/*
+ * analysis_manager.cpp - cached CFG and dataflow analyses for the optimizer
+ *
+ * Josh Meise
+ * 10-18-2026
+ * Description:
+ * - Computes predecessors, reverse post-order, dominators and dominance frontiers of a function.
+ * - Dominator tree with depth-first numbering for constant-time dominance queries.
+ * - Natural loops found from back edges.
+ * - Computes reaching stores and live loads with the dataflow framework.
+ * - Caches all results per function until a pass reports that it did not preserve them.
+ *
+ */
+
+#include "analysis_manager.h"
+#include "dataflow.h"
+#include <algorithm>
+#include <iostream>
+
+/*
+ * Gets the successors of a basic block.
+ * Blocks without a terminator (empty blocks left behind by IR generation) have no successors.
+ *
+ * Args:
+ * - bb: basic block whose successors to find.
+ *
+ * Returns:
+ * - Successors of the basic block in terminator order.
+ */
+std::vector<LLVMBasicBlockRef> get_successors(LLVMBasicBlockRef bb) {
+    LLVMValueRef term;
+    std::vector<LLVMBasicBlockRef> succs;
+    unsigned int num;
+
+    if (bb == NULL || (term = LLVMGetBasicBlockTerminator(bb)) == NULL) return succs;
+
+    for (num = 0; num < LLVMGetNumSuccessors(term); num++)
+        succs.push_back(LLVMGetSuccessor(term, num));
+
+    return succs;
+}
+
+/*
+ * Computes predecessor lists for all basic blocks of a function.
+ *
+ * Args:
+ * - f: function whose predecessors to compute.
+ *
+ * Returns:
+ * - Map from each basic block to its predecessors.
+ */
+static std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> compute_preds(LLVMValueRef f) {
+    LLVMBasicBlockRef bb;
+    std::vector<LLVMBasicBlockRef> succs;
+    std::vector<LLVMBasicBlockRef>::iterator it;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> preds;
+
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb))
+        preds.insert({bb, std::vector<LLVMBasicBlockRef>()});
+
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        succs = get_successors(bb);
+        for (it = succs.begin(); it != succs.end(); ++it) preds[*it].push_back(bb);
+    }
+
+    return preds;
+}
+
+/*
+ * Computes reverse post-order of the basic blocks reachable from the entry of a function.
+ *
+ * Args:
+ * - f: function whose blocks to order.
+ *
+ * Returns:
+ * - Reachable basic blocks in reverse post-order (entry first).
+ */
+static std::vector<LLVMBasicBlockRef> compute_rpo(LLVMValueRef f) {
+    std::vector<LLVMBasicBlockRef> order;
+    std::vector<std::pair<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>> stack;
+    std::unordered_set<LLVMBasicBlockRef> visited;
+    LLVMBasicBlockRef entry, succ;
+
+    if (f == NULL || (entry = LLVMGetFirstBasicBlock(f)) == NULL) return order;
+
+    // Depth-first search with an explicit stack of blocks and their unvisited successors.
+    visited.insert(entry);
+    stack.push_back({entry, get_successors(entry)});
+    while (!stack.empty()) {
+        if (stack.back().second.empty()) {
+            // All successors visited; block is finished.
+            order.push_back(stack.back().first);
+            stack.pop_back();
+        } else {
+            succ = stack.back().second.back();
+            stack.back().second.pop_back();
+            if (!visited.contains(succ)) {
+                visited.insert(succ);
+                stack.push_back({succ, get_successors(succ)});
+            }
+        }
+    }
+
+    // Reverse post-order.
+    return std::vector<LLVMBasicBlockRef>(order.rbegin(), order.rend());
+}
+
+/*
+ * Computes immediate dominators using the Cooper-Harvey-Kennedy iterative algorithm.
+ * Only blocks reachable from the entry receive an immediate dominator; the entry is its own.
+ *
+ * Args:
+ * - rpo: reachable blocks in reverse post-order.
+ * - preds: predecessor lists for all blocks.
+ *
+ * Returns:
+ * - Map from each reachable block to its immediate dominator.
+ */
+static std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> compute_idoms(const std::vector<LLVMBasicBlockRef>& rpo, const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& preds) {
+    std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> idom;
+    std::unordered_map<LLVMBasicBlockRef, size_t> rpo_num;
+    std::vector<LLVMBasicBlockRef>::const_iterator it;
+    LLVMBasicBlockRef new_idom, f1, f2;
+    size_t k;
+    bool change;
+
+    if (rpo.empty()) return idom;
+
+    for (k = 0; k < rpo.size(); k++) rpo_num[rpo[k]] = k;
+
+    idom[rpo[0]] = rpo[0];
+    do {
+        change = false;
+        for (k = 1; k < rpo.size(); k++) {
+            new_idom = NULL;
+            for (it = preds.at(rpo[k]).begin(); it != preds.at(rpo[k]).end(); ++it) {
+                // Skip predecessors that are unreachable or not yet processed.
+                if (!idom.contains(*it)) continue;
+
+                if (new_idom == NULL) new_idom = *it;
+                else {
+                    // Walk both fingers up the dominator tree until they meet.
+                    f1 = *it;
+                    f2 = new_idom;
+                    while (f1 != f2) {
+                        while (rpo_num[f1] > rpo_num[f2]) f1 = idom[f1];
+                        while (rpo_num[f2] > rpo_num[f1]) f2 = idom[f2];
+                    }
+                    new_idom = f1;
+                }
+            }
+
+            if (!idom.contains(rpo[k]) || idom[rpo[k]] != new_idom) {
+                idom[rpo[k]] = new_idom;
+                change = true;
+            }
+        }
+    } while (change);
+
+    return idom;
+}
+
+/*
+ * Computes dominance frontiers of all reachable blocks.
+ *
+ * Args:
+ * - rpo: reachable blocks in reverse post-order.
+ * - preds: predecessor lists for all blocks.
+ * - idom: immediate dominators of reachable blocks.
+ *
+ * Returns:
+ * - Map from each reachable block to its dominance frontier.
+ */
+static std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> compute_dominance_frontiers(const std::vector<LLVMBasicBlockRef>& rpo, const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& preds, const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& idom) {
+    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> df;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it, pred_it;
+    LLVMBasicBlockRef runner;
+
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) df.insert({*bb_it, std::set<LLVMBasicBlockRef>()});
+
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) {
+        // Only join points can be in a dominance frontier.
+        if (preds.at(*bb_it).size() < 2) continue;
+
+        for (pred_it = preds.at(*bb_it).begin(); pred_it != preds.at(*bb_it).end(); ++pred_it) {
+            if (!idom.contains(*pred_it)) continue;
+
+            // Block is in the frontier of every block from the predecessor up to (excluding) its immediate dominator.
+            for (runner = *pred_it; runner != idom.at(*bb_it); runner = idom.at(runner)) {
+                df[runner].insert(*bb_it);
+                if (runner == idom.at(runner)) break;
+            }
+        }
+    }
+
+    return df;
+}
+
+/*
+ * Computes immediate post-dominators with the Cooper-Harvey-Kennedy algorithm on the reverse CFG.
+ * Blocks without successors are joined under a virtual exit, represented by NULL.
+ * Each region of blocks that cannot reach an exit (an infinite loop) also gets a virtual edge to the exit, from its last block
+ * in reverse post-order, so that every block has a post-dominator and the branches leading into the loop are control dependences.
+ *
+ * Args:
+ * - rpo: reachable blocks in reverse post-order.
+ * - preds: predecessor lists for all blocks.
+ *
+ * Returns:
+ * - Map from each reachable block to its immediate post-dominator, or NULL for the virtual exit.
+ */
+static std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> compute_post_idoms(const std::vector<LLVMBasicBlockRef>& rpo, const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& preds) {
+    std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> ipdom;
+    std::unordered_map<LLVMBasicBlockRef, size_t> index;
+    std::vector<std::vector<size_t>> rsuccs, rpreds;
+    std::vector<std::pair<size_t, size_t>> stack;
+    std::vector<size_t> order, num, idom;
+    std::vector<LLVMBasicBlockRef> succs;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::vector<size_t>::const_iterator it;
+    size_t n, k, b, new_idom, f1, f2, none;
+    bool change;
+
+    // Block k is node k; the virtual exit is node n.
+    n = rpo.size();
+    none = n + 1;
+    for (k = 0; k < n; k++) index[rpo[k]] = k;
+
+    // Edges of the reverse CFG: rsuccs follow CFG predecessors, rpreds follow CFG successors.
+    rsuccs.assign(n + 1, std::vector<size_t>());
+    rpreds.assign(n + 1, std::vector<size_t>());
+    for (k = 0; k < n; k++) {
+        succs = get_successors(rpo[k]);
+        if (succs.empty()) {
+            rsuccs[n].push_back(k);
+            rpreds[k].push_back(n);
+        }
+        for (bb_it = succs.begin(); bb_it != succs.end(); ++bb_it) rpreds[k].push_back(index.at(*bb_it));
+        for (bb_it = preds.at(rpo[k]).begin(); bb_it != preds.at(rpo[k]).end(); ++bb_it)
+            if (index.contains(*bb_it)) rsuccs[k].push_back(index.at(*bb_it));
+    }
+
+    // Post-order of the reverse CFG from the virtual exit, redone after each virtual edge out of an infinite loop.
+    do {
+        num.assign(n + 1, none);
+        order.clear();
+        stack.push_back({n, 0});
+        num[n] = 0;
+        while (!stack.empty()) {
+            b = stack.back().first;
+            if (stack.back().second < rsuccs[b].size()) {
+                k = rsuccs[b][stack.back().second++];
+                if (num[k] == none) {
+                    num[k] = 0;
+                    stack.push_back({k, 0});
+                }
+            } else {
+                order.push_back(b);
+                stack.pop_back();
+            }
+        }
+
+        for (k = n; k-- > 0;) {
+            if (num[k] != none) continue;
+            rsuccs[n].push_back(k);
+            rpreds[k].push_back(n);
+            break;
+        }
+    } while (order.size() < n + 1);
+    for (k = 0; k < order.size(); k++) num[order[k]] = k;
+
+    // Higher post-order number means closer to the exit; the exit is the root.
+    idom.assign(n + 1, none);
+    idom[n] = n;
+    do {
+        change = false;
+        for (k = order.size() - 1; k-- > 0;) {
+            b = order[k];
+            new_idom = none;
+            for (it = rpreds[b].begin(); it != rpreds[b].end(); ++it) {
+                if (idom[*it] == none) continue;
+
+                if (new_idom == none) new_idom = *it;
+                else {
+                    f1 = *it;
+                    f2 = new_idom;
+                    while (f1 != f2) {
+                        while (num[f1] < num[f2]) f1 = idom[f1];
+                        while (num[f2] < num[f1]) f2 = idom[f2];
+                    }
+                    new_idom = f1;
+                }
+            }
+
+            if (idom[b] != new_idom) {
+                idom[b] = new_idom;
+                change = true;
+            }
+        }
+    } while (change);
+
+    for (k = 0; k < n; k++) ipdom[rpo[k]] = idom[k] == n ? NULL : rpo[idom[k]];
+
+    return ipdom;
+}
+
+/*
+ * Computes post-dominance frontiers: b is in the frontier of x when x post-dominates a successor of b but not b itself,
+ * i.e. x is control dependent on the branch at the end of b.
+ *
+ * Args:
+ * - ipdom: immediate post-dominators; NULL stands for the virtual exit.
+ *
+ * Returns:
+ * - Map from each block to the blocks whose branches it is control dependent on.
+ */
+static std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> compute_post_dominance_frontiers(const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& ipdom) {
+    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> pdf;
+    std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>::const_iterator bb_it;
+    std::vector<LLVMBasicBlockRef> succs;
+    std::vector<LLVMBasicBlockRef>::iterator succ_it;
+    LLVMBasicBlockRef runner;
+
+    for (bb_it = ipdom.begin(); bb_it != ipdom.end(); ++bb_it) pdf.insert({bb_it->first, std::set<LLVMBasicBlockRef>()});
+
+    for (bb_it = ipdom.begin(); bb_it != ipdom.end(); ++bb_it) {
+        succs = get_successors(bb_it->first);
+        if (succs.size() < 2) continue;
+
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it)
+            for (runner = *succ_it; runner != NULL && runner != bb_it->second && ipdom.contains(runner); runner = ipdom.at(runner))
+                pdf[runner].insert(bb_it->first);
+    }
+
+    return pdf;
+}
+
+/*
+ * Gets the memory location a load or store instruction accesses.
+ */
+static LLVMValueRef get_location(LLVMValueRef i) {
+    return LLVMGetInstructionOpcode(i) == LLVMStore ? LLVMGetOperand(i, 1) : LLVMGetOperand(i, 0);
+}
+
+/*
+ * Numbers the basic blocks of a function and the instructions with a given opcode densely from zero, and records the CFG by block number.
+ * Dataflow sets are bit vectors indexed by instruction number and stored in vectors indexed by block number.
+ * Blocks are numbered in reverse post-order, with unreachable blocks after all reachable ones, so that
+ * ascending block numbers visit predecessors before successors wherever possible.
+ * Tracked instructions are grouped by location so that passes never scan all of them to find one variable's.
+ *
+ * Args:
+ * - f: function to number.
+ * - op: opcode of instructions tracked by the dataflow problem.
+ *
+ * Returns:
+ * - Numbering of blocks and instructions.
+ */
+DataflowNumbering number_function(LLVMValueRef f, LLVMOpcode op) {
+    LLVMValueRef i;
+    LLVMBasicBlockRef bb;
+    DataflowNumbering num;
+    std::vector<LLVMBasicBlockRef> succs;
+    std::vector<LLVMBasicBlockRef>::iterator bb_it, succ_it;
+
+    // Reachable blocks in reverse post-order.
+    num.blocks = compute_rpo(f);
+    for (bb_it = num.blocks.begin(); bb_it != num.blocks.end(); ++bb_it)
+        num.block_num[*bb_it] = bb_it - num.blocks.begin();
+
+    // Unreachable blocks in layout order.
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        if (!num.block_num.contains(bb)) {
+            num.block_num[bb] = num.blocks.size();
+            num.blocks.push_back(bb);
+        }
+    }
+
+    // Predecessor and successor lists by block number.
+    num.preds.assign(num.blocks.size(), std::vector<size_t>());
+    num.succs.assign(num.blocks.size(), std::vector<size_t>());
+    for (bb_it = num.blocks.begin(); bb_it != num.blocks.end(); ++bb_it) {
+        succs = get_successors(*bb_it);
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it) {
+            num.succs[num.block_num[*bb_it]].push_back(num.block_num[*succ_it]);
+            num.preds[num.block_num[*succ_it]].push_back(num.block_num[*bb_it]);
+        }
+    }
+
+    for (bb_it = num.blocks.begin(); bb_it != num.blocks.end(); ++bb_it) {
+        for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (LLVMGetInstructionOpcode(i) == op) {
+                num.instr_num[i] = num.instrs.size();
+                num.by_location[get_location(i)].push_back(num.instrs.size());
+                num.instrs.push_back(i);
+            }
+        }
+    }
+
+    return num;
+}
+
+/*
+ * Given a set of load or store instructions and an operand, checks to see if there are loads or stores to the same location in the set.
+ * Only the instructions indexed under that location are examined, not the whole set.
+ *
+ * Args:
+ * - set: set of load or store instruction numbers.
+ * - num: numbering the set refers to.
+ * - operand: location to search for
+ *
+ * Returns:
+ * - Numbers of instructions to same location as operand
+ */
+std::vector<size_t> find_instrs_with_operand(const BitVector& set, const DataflowNumbering& num, LLVMValueRef operand) {
+    std::unordered_map<LLVMValueRef, std::vector<size_t>>::const_iterator group;
+    std::vector<size_t>::const_iterator it;
+    std::vector<size_t> matches;
+
+    if ((group = num.by_location.find(operand)) == num.by_location.end()) return matches;
+
+    for (it = group->second.begin(); it != group->second.end(); ++it)
+        if (set.test(*it)) matches.push_back(*it);
+
+    return matches;
+}
+
+/*
+ * Computes GEN set for all basic blocks of a function using forward analysis.
+ * GEN sets take the form of a vector of store sets indexed by block number.
+ *
+ * Args:
+ * - f: function for which to compute set.
+ * - num: numbering of blocks and store instructions.
+ *
+ * Returns:
+ * - Computed GEN set, nullopt if failure
+ */
+static std::optional<std::vector<BitVector>> compute_gen_fa(LLVMValueRef f, DataflowNumbering& num) {
+    LLVMValueRef i;
+    std::unordered_map<LLVMValueRef, size_t> last;
+    std::unordered_map<LLVMValueRef, size_t>::iterator last_it;
+    std::vector<BitVector> gen_fa;
+    size_t b;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return std::nullopt;
+    }
+
+    // Create an empty gen set for each basic block.
+    gen_fa.assign(num.blocks.size(), BitVector(num.instrs.size()));
+
+    for (b = 0; b < num.blocks.size(); b++) {
+        // Only the last store to each location in the block is generated.
+        last.clear();
+        for (i = LLVMGetFirstInstruction(num.blocks[b]); i != NULL; i = LLVMGetNextInstruction(i))
+            if (LLVMGetInstructionOpcode(i) == LLVMStore) last[LLVMGetOperand(i, 1)] = num.instr_num[i];
+
+        for (last_it = last.begin(); last_it != last.end(); ++last_it) gen_fa[b].set(last_it->second);
+    }
+
+    return gen_fa;
+}
+
+/*
+ * Computes KILL set for all basic blocks of a function using forward analysis.
+ * KILL sets take the form of a vector of store sets indexed by block number.
+ *
+ * Args:
+ * - f: function for which to compute set.
+ * - num: numbering of blocks and store instructions.
+ *
+ * Returns:
+ * - Computed KILL set, nullopt if failure.
+ */
+static std::optional<std::vector<BitVector>> compute_kill_fa(LLVMValueRef f, DataflowNumbering& num) {
+    LLVMValueRef i;
+    std::unordered_map<LLVMValueRef, std::vector<size_t>> stored;
+    std::unordered_map<LLVMValueRef, std::vector<size_t>>::iterator loc_it;
+    std::vector<size_t>::const_iterator k;
+    std::vector<BitVector> kill_fa;
+    size_t b;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return std::nullopt;
+    }
+
+    // Kill set for each basic block starts off as empty set.
+    kill_fa.assign(num.blocks.size(), BitVector(num.instrs.size()));
+
+    for (b = 0; b < num.blocks.size(); b++) {
+        // Group the block's stores by location.
+        stored.clear();
+        for (i = LLVMGetFirstInstruction(num.blocks[b]); i != NULL; i = LLVMGetNextInstruction(i))
+            if (LLVMGetInstructionOpcode(i) == LLVMStore) stored[LLVMGetOperand(i, 1)].push_back(num.instr_num[i]);
+
+        // A store kills every other store to its location; a lone store to a location does not kill itself.
+        for (loc_it = stored.begin(); loc_it != stored.end(); ++loc_it) {
+            const std::vector<size_t>& group = num.by_location.at(loc_it->first);
+            for (k = group.begin(); k != group.end(); ++k) kill_fa[b].set(*k);
+            if (loc_it->second.size() == 1) kill_fa[b].reset(loc_it->second.front());
+        }
+    }
+
+    return kill_fa;
+}
+
+/*
+ * Computes GEN set for all basic blocks of a function using reverse analysis.
+ * GEN sets take the form of a vector of load sets indexed by block number.
+ *
+ * Args:
+ * - f (LLVMValueRef): function for which to compute set.
+ * - num: numbering of blocks and load instructions.
+ *
+ * Returns:
+ * - Computed GEN set, nullopt if failure
+ */
+static std::optional<std::vector<BitVector>> compute_gen_ra(LLVMValueRef f, DataflowNumbering& num) {
+    LLVMValueRef i;
+    std::set<LLVMValueRef> stores;
+    std::vector<BitVector> gen_ra;
+    size_t b;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return std::nullopt;
+    }
+
+    // Create an empty gen set for each basic block.
+    gen_ra.assign(num.blocks.size(), BitVector(num.instrs.size()));
+
+    for (b = 0; b < num.blocks.size(); b++) {
+        // Create set of all store locations in this basic block.
+        stores = std::set<LLVMValueRef>();
+
+        for (i = LLVMGetFirstInstruction(num.blocks[b]); i != NULL; i = LLVMGetNextInstruction(i))
+            // Only add load instructions for which no store instructions exist in the same basic block to GEN set.
+            if (LLVMGetInstructionOpcode(i) == LLVMLoad && !stores.contains(LLVMGetOperand(i, 0))) gen_ra[b].set(num.instr_num[i]);
+            // Add store instructions to set of stores.
+            else if (LLVMGetInstructionOpcode(i) == LLVMStore) stores.insert(LLVMGetOperand(i, 1));
+    }
+
+    return gen_ra;
+}
+
+/*
+ * Computes KILL set for all basic blocks of a function using reverse analysis.
+ * KILL sets take the form of a vector of load sets indexed by block number.
+ *
+ * Args:
+ * - f (LLVMValueRef): function for which to compute set.
+ * - num: numbering of blocks and load instructions.
+ *
+ * Returns:
+ * - Computed KILL set, nullopt if failure
+ */
+static std::optional<std::vector<BitVector>> compute_kill_ra(LLVMValueRef f, DataflowNumbering& num) {
+    LLVMValueRef i;
+    std::unordered_set<LLVMValueRef> stored;
+    std::unordered_set<LLVMValueRef>::iterator loc_it;
+    std::unordered_map<LLVMValueRef, std::vector<size_t>>::const_iterator group;
+    std::vector<size_t>::const_iterator k;
+    std::vector<BitVector> kill_ra;
+    size_t b;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return std::nullopt;
+    }
+
+    // Create an empty kill set for each basic block.
+    kill_ra.assign(num.blocks.size(), BitVector(num.instrs.size()));
+
+    for (b = 0; b < num.blocks.size(); b++) {
+        // Locations stored to in this block.
+        stored.clear();
+        for (i = LLVMGetFirstInstruction(num.blocks[b]); i != NULL; i = LLVMGetNextInstruction(i))
+            if (LLVMGetInstructionOpcode(i) == LLVMStore) stored.insert(LLVMGetOperand(i, 1));
+
+        // A store kills every load of its location.
+        for (loc_it = stored.begin(); loc_it != stored.end(); ++loc_it) {
+            if ((group = num.by_location.find(*loc_it)) == num.by_location.end()) continue;
+            for (k = group->second.begin(); k != group->second.end(); ++k) kill_ra[b].set(*k);
+        }
+    }
+
+    return kill_ra;
+}
+
+/*
+ * Default constructor for DomTree object.
+ *
+ * Returns:
+ * - DomTree: empty tree.
+ */
+DomTree::DomTree(void) {
+    root = NULL;
+}
+
+/*
+ * Constructs a dominator tree from immediate dominators and numbers it depth-first.
+ *
+ * Args:
+ * - rpo: reachable blocks in reverse post-order.
+ * - idoms: immediate dominators of reachable blocks; the entry is its own.
+ *
+ * Returns:
+ * - DomTree: tree over the reachable blocks.
+ */
+DomTree::DomTree(const std::vector<LLVMBasicBlockRef>& rpo, const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& idoms) {
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::vector<std::pair<LLVMBasicBlockRef, size_t>> stack;
+    LLVMBasicBlockRef bb;
+    size_t counter;
+
+    root = rpo.empty() ? NULL : rpo[0];
+    if (root == NULL) return;
+
+    // Children in reverse post-order so the tree walk is deterministic.
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) {
+        idom[*bb_it] = idoms.at(*bb_it);
+        if (*bb_it != root) children[idoms.at(*bb_it)].push_back(*bb_it);
+    }
+
+    // Depth-first walk with an explicit stack of blocks and the index of their next child.
+    counter = 0;
+    dfs_num[root].first = counter++;
+    preorder.push_back(root);
+    stack.push_back({root, 0});
+    while (!stack.empty()) {
+        bb = stack.back().first;
+        if (stack.back().second < get_children(bb).size()) {
+            bb = get_children(bb)[stack.back().second++];
+            dfs_num[bb].first = counter++;
+            preorder.push_back(bb);
+            stack.push_back({bb, 0});
+        } else {
+            dfs_num[bb].second = counter++;
+            stack.pop_back();
+        }
+    }
+}
+
+/*
+ * Getter method for the entry block.
+ */
+LLVMBasicBlockRef DomTree::get_root(void) const { return root; }
+
+/*
+ * Gets the immediate dominator of a block; NULL for the entry and for unreachable blocks.
+ */
+LLVMBasicBlockRef DomTree::get_idom(LLVMBasicBlockRef bb) const {
+    if (bb == root || !idom.contains(bb)) return NULL;
+    return idom.at(bb);
+}
+
+/*
+ * Gets the blocks immediately dominated by a block.
+ */
+const std::vector<LLVMBasicBlockRef>& DomTree::get_children(LLVMBasicBlockRef bb) const {
+    if (!children.contains(bb)) return no_children;
+    return children.at(bb);
+}
+
+/*
+ * Getter method for the reachable blocks in dominator tree preorder.
+ */
+const std::vector<LLVMBasicBlockRef>& DomTree::get_preorder(void) const { return preorder; }
+
+/*
+ * Checks whether a block is reachable, i.e. in the tree.
+ */
+bool DomTree::contains(LLVMBasicBlockRef bb) const { return dfs_num.contains(bb); }
+
+/*
+ * Checks whether block a dominates block b (every block dominates itself).
+ *
+ * Args:
+ * - a: candidate dominator.
+ * - b: candidate dominated block.
+ *
+ * Returns:
+ * - True if a dominates b, false otherwise or if either block is unreachable.
+ */
+bool DomTree::dominates(LLVMBasicBlockRef a, LLVMBasicBlockRef b) const {
+    if (!contains(a) || !contains(b)) return false;
+    return dfs_num.at(a).first <= dfs_num.at(b).first && dfs_num.at(b).second <= dfs_num.at(a).second;
+}
+
+/*
+ * Finds the natural loops of a function.
+ * An edge latch -> header is a back edge when the header dominates the latch; the loop is the header plus
+ * every block that reaches a latch without passing through the header. Back edges sharing a header form one loop.
+ * A loop's preheader is its header's only outside predecessor, provided that block branches nowhere else.
+ *
+ * Args:
+ * - rpo: reachable blocks in reverse post-order.
+ * - preds: predecessor lists for all blocks.
+ * - dt: dominator tree.
+ *
+ * Returns:
+ * - Loops ordered innermost first, with blocks of each loop in reverse post-order.
+ */
+static std::vector<Loop> compute_loops(const std::vector<LLVMBasicBlockRef>& rpo, const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& preds, const DomTree& dt) {
+    std::vector<Loop> loops;
+    std::vector<Loop>::iterator loop_it, other_it;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it, pred_it;
+    std::vector<LLVMBasicBlockRef> work, outside;
+    LLVMBasicBlockRef bb;
+    Loop loop;
+
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) {
+        loop = Loop();
+        loop.header = *bb_it;
+        loop.preheader = NULL;
+        loop.depth = 0;
+
+        // Back edges into this block.
+        for (pred_it = preds.at(*bb_it).begin(); pred_it != preds.at(*bb_it).end(); ++pred_it)
+            if (dt.dominates(*bb_it, *pred_it)) loop.latches.push_back(*pred_it);
+
+        if (loop.latches.empty()) continue;
+
+        // Walk backwards from the latches, stopping at the header.
+        loop.block_set.insert(loop.header);
+        work = loop.latches;
+        while (!work.empty()) {
+            bb = work.back();
+            work.pop_back();
+            if (loop.block_set.contains(bb) || !dt.contains(bb)) continue;
+
+            loop.block_set.insert(bb);
+            for (pred_it = preds.at(bb).begin(); pred_it != preds.at(bb).end(); ++pred_it) work.push_back(*pred_it);
+        }
+
+        for (pred_it = rpo.begin(); pred_it != rpo.end(); ++pred_it)
+            if (loop.block_set.contains(*pred_it)) loop.blocks.push_back(*pred_it);
+
+        // Dedicated preheader: single outside predecessor with a single successor.
+        outside.clear();
+        for (pred_it = preds.at(loop.header).begin(); pred_it != preds.at(loop.header).end(); ++pred_it)
+            if (!loop.block_set.contains(*pred_it)) outside.push_back(*pred_it);
+        if (outside.size() == 1 && get_successors(outside[0]).size() == 1)
+            loop.preheader = outside[0];
+
+        loops.push_back(loop);
+    }
+
+    // Nesting depth is the number of loops containing the header.
+    for (loop_it = loops.begin(); loop_it != loops.end(); ++loop_it)
+        for (other_it = loops.begin(); other_it != loops.end(); ++other_it)
+            if (other_it->block_set.contains(loop_it->header)) loop_it->depth++;
+
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.depth > b.depth; });
+
+    return loops;
+}
+
+/*
+ * Finds the basic induction variables of a loop in SSA form.
+ * A header phi qualifies when its value from the preheader is init and its value from the single latch is
+ * phi + c, c + phi or phi - c for a constant c.
+ *
+ * Args:
+ * - loop: loop with a preheader and a single latch.
+ *
+ * Returns:
+ * - The induction variables of the loop header, empty if the loop does not have that shape.
+ */
+std::vector<InductionVariable> find_induction_variables(const Loop& loop) {
+    std::vector<InductionVariable> ivs;
+    InductionVariable iv;
+    LLVMValueRef i, update, other;
+    LLVMOpcode op;
+    unsigned int k;
+
+    if (loop.preheader == NULL || loop.latches.size() != 1) return ivs;
+
+    for (i = LLVMGetFirstInstruction(loop.header); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = LLVMGetNextInstruction(i)) {
+        if (LLVMCountIncoming(i) != 2) continue;
+
+        iv.phi = i;
+        iv.init = NULL;
+        update = NULL;
+        for (k = 0; k < 2; k++) {
+            if (LLVMGetIncomingBlock(i, k) == loop.preheader) iv.init = LLVMGetIncomingValue(i, k);
+            else if (LLVMGetIncomingBlock(i, k) == loop.latches[0]) update = LLVMGetIncomingValue(i, k);
+        }
+        if (iv.init == NULL || update == NULL || !LLVMIsAInstruction(update)) continue;
+
+        // Update must be the phi plus or minus a constant.
+        op = LLVMGetInstructionOpcode(update);
+        if (op == LLVMAdd && LLVMGetOperand(update, 0) == i) other = LLVMGetOperand(update, 1);
+        else if (op == LLVMAdd && LLVMGetOperand(update, 1) == i) other = LLVMGetOperand(update, 0);
+        else if (op == LLVMSub && LLVMGetOperand(update, 0) == i) other = LLVMGetOperand(update, 1);
+        else continue;
+
+        if (!LLVMIsAConstantInt(other)) continue;
+
+        iv.update = update;
+        iv.step = LLVMConstIntGetSExtValue(other);
+        if (op == LLVMSub) iv.step = -iv.step;
+        ivs.push_back(iv);
+    }
+
+    return ivs;
+}
+
+/*
+ * Default constructor for AnalysisManager object.
+ *
+ * Returns:
+ * - AnalysisManager: object with an empty cache.
+ */
+AnalysisManager::AnalysisManager(void) {
+    dataflow_visits = 0;
+    num_reused = 0;
+}
+
+/*
+ * Gets predecessor lists of all basic blocks of a function, computing them if not cached.
+ */
+const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& AnalysisManager::get_preds(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.preds.has_value()) num_reused++;
+    else fa.preds = compute_preds(f);
+
+    return fa.preds.value();
+}
+
+/*
+ * Gets reachable basic blocks of a function in reverse post-order, computing them if not cached.
+ */
+const std::vector<LLVMBasicBlockRef>& AnalysisManager::get_rpo(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.rpo.has_value()) num_reused++;
+    else fa.rpo = compute_rpo(f);
+
+    return fa.rpo.value();
+}
+
+/*
+ * Gets immediate dominators of reachable basic blocks of a function, computing them if not cached.
+ */
+const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& AnalysisManager::get_idoms(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.idoms.has_value()) num_reused++;
+    else fa.idoms = compute_idoms(get_rpo(f), get_preds(f));
+
+    return fa.idoms.value();
+}
+
+/*
+ * Gets the dominator tree of a function, computing it if not cached.
+ */
+const DomTree& AnalysisManager::get_dom_tree(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.dom_tree.has_value()) num_reused++;
+    else fa.dom_tree = DomTree(get_rpo(f), get_idoms(f));
+
+    return fa.dom_tree.value();
+}
+
+/*
+ * Gets dominance frontiers of reachable basic blocks of a function, computing them if not cached.
+ */
+const std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>& AnalysisManager::get_dominance_frontiers(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.dominance_frontiers.has_value()) num_reused++;
+    else fa.dominance_frontiers = compute_dominance_frontiers(get_rpo(f), get_preds(f), get_idoms(f));
+
+    return fa.dominance_frontiers.value();
+}
+
+/*
+ * Gets the natural loops of a function, innermost first, computing them if not cached.
+ */
+const std::vector<Loop>& AnalysisManager::get_loops(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.loops.has_value()) num_reused++;
+    else fa.loops = compute_loops(get_rpo(f), get_preds(f), get_dom_tree(f));
+
+    return fa.loops.value();
+}
+
+/*
+ * Returns the cached immediate post-dominators of a function, computing them if needed.
+ * Blocks mapped to NULL are immediately post-dominated by the virtual exit.
+ */
+const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& AnalysisManager::get_post_idoms(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.post_idoms.has_value()) num_reused++;
+    else fa.post_idoms = compute_post_idoms(get_rpo(f), get_preds(f));
+
+    return fa.post_idoms.value();
+}
+
+/*
+ * Returns the cached post-dominance frontiers (control dependences) of a function, computing them if needed.
+ */
+const std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>& AnalysisManager::get_post_dominance_frontiers(LLVMValueRef f) {
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.post_dominance_frontiers.has_value()) num_reused++;
+    else fa.post_dominance_frontiers = compute_post_dominance_frontiers(get_post_idoms(f));
+
+    return fa.post_dominance_frontiers.value();
+}
+
+/*
+ * Gets the stores reaching the entry and exit of each basic block of a function, computing them if not cached.
+ * Reaching stores are a forward may problem starting from no stores.
+ *
+ * Args:
+ * - f: function to analyze.
+ *
+ * Returns:
+ * - Numbering of stores and IN/OUT sets, NULL on failure.
+ */
+const MemoryDataflow* AnalysisManager::get_reaching_stores(LLVMValueRef f) {
+    MemoryDataflow md;
+    std::vector<BitVector> gen_fa, kill_fa;
+    std::optional<std::vector<BitVector>> opt_vec;
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.reaching_stores.has_value()) {
+        num_reused++;
+        return &fa.reaching_stores.value();
+    }
+
+    // Number blocks and store instructions.
+    md.num = number_function(f, LLVMStore);
+
+    // Compute relevant sets.
+    opt_vec = compute_gen_fa(f, md.num);
+    if (!opt_vec.has_value()) return NULL;
+    else gen_fa = opt_vec.value();
+    opt_vec = compute_kill_fa(f, md.num);
+    if (!opt_vec.has_value()) return NULL;
+    else kill_fa = opt_vec.value();
+
+    Dataflow<Direction::Forward, BitVector, GenKillTransfer, UnionMeet> reaching(md.num.preds, md.num.succs, BitVector(md.num.instrs.size()), BitVector(md.num.instrs.size()), GenKillTransfer{gen_fa, kill_fa}, UnionMeet{});
+    dataflow_visits += reaching.solve();
+    md.in = reaching.get_in();
+    md.out = reaching.get_out();
+
+    fa.reaching_stores = std::move(md);
+    return &fa.reaching_stores.value();
+}
+
+/*
+ * Gets the loads live at the entry and exit of each basic block of a function, computing them if not cached.
+ * Live loads are a backward may problem starting from no loads.
+ *
+ * Args:
+ * - f: function to analyze.
+ *
+ * Returns:
+ * - Numbering of loads and IN/OUT sets, NULL on failure.
+ */
+const MemoryDataflow* AnalysisManager::get_live_loads(LLVMValueRef f) {
+    MemoryDataflow md;
+    std::vector<BitVector> gen_ra, kill_ra;
+    std::optional<std::vector<BitVector>> opt_vec;
+    FunctionAnalyses& fa = cache[f];
+
+    if (fa.live_loads.has_value()) {
+        num_reused++;
+        return &fa.live_loads.value();
+    }
+
+    // Number blocks and load instructions.
+    md.num = number_function(f, LLVMLoad);
+
+    // Compute relevant sets.
+    opt_vec = compute_gen_ra(f, md.num);
+    if (!opt_vec.has_value()) return NULL;
+    else gen_ra = opt_vec.value();
+    opt_vec = compute_kill_ra(f, md.num);
+    if (!opt_vec.has_value()) return NULL;
+    else kill_ra = opt_vec.value();
+
+    Dataflow<Direction::Backward, BitVector, GenKillTransfer, UnionMeet> live(md.num.preds, md.num.succs, BitVector(md.num.instrs.size()), BitVector(md.num.instrs.size()), GenKillTransfer{gen_ra, kill_ra}, UnionMeet{});
+    dataflow_visits += live.solve();
+    md.in = live.get_in();
+    md.out = live.get_out();
+
+    fa.live_loads = std::move(md);
+    return &fa.live_loads.value();
+}
+
+/*
+ * Drops cached analyses of a function that a pass did not preserve.
+ *
+ * Args:
+ * - f: function that was changed.
+ * - preserved: union of PreservedAnalyses flags reported by the pass.
+ */
+void AnalysisManager::invalidate(LLVMValueRef f, unsigned preserved) {
+    if (!cache.contains(f)) return;
+
+    if (!(preserved & PRESERVE_CFG)) {
+        cache.erase(f);
+        return;
+    }
+
+    if (!(preserved & PRESERVE_REACHING_STORES)) cache[f].reaching_stores.reset();
+    if (!(preserved & PRESERVE_LIVE_LOADS)) cache[f].live_loads.reset();
+}
+
+/*
+ * Drops all cached analyses.
+ */
+void AnalysisManager::clear(void) { cache.clear(); }
+
+/*
+ * Getter method for the number of basic block visits made by the dataflow solvers.
+ */
+size_t AnalysisManager::get_dataflow_visits(void) const { return dataflow_visits; }
+
+/*
+ * Getter method for the number of analysis requests answered from the cache.
+ */
+size_t AnalysisManager::get_num_reused(void) const { return num_reused; }
@@ -0,0 +1,155 @@
+/*
+ * analysis_manager.h - cached CFG and dataflow analyses for the optimizer
+ *
+ * Josh Meise
+ * 10-18-2026
+ * Description:
+ * - Computes predecessors, reverse post-order, dominators and dominance frontiers of a function.
+ * - Dominator tree with depth-first numbering for constant-time dominance queries.
+ * - Post-dominators and post-dominance frontiers (control dependences).
+ * - Natural loops found from back edges, and the basic induction variables of a loop.
+ * - Computes reaching stores and live loads with the dataflow framework.
+ * - Caches all results per function until a pass reports that it did not preserve them.
+ *
+ */
+
+#pragma once
+#include <llvm-c/Core.h>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "bitvector.h"
+
+/*
+ * Analyses a pass may leave intact; passes report the union of those they preserve.
+ * Dataflow results depend on the CFG, so not preserving the CFG invalidates everything.
+ */
+enum PreservedAnalyses : unsigned {
+    PRESERVE_NONE = 0,
+    PRESERVE_CFG = 1 << 0,
+    PRESERVE_REACHING_STORES = 1 << 1,
+    PRESERVE_LIVE_LOADS = 1 << 2,
+    PRESERVE_ALL = PRESERVE_CFG | PRESERVE_REACHING_STORES | PRESERVE_LIVE_LOADS
+};
+
+/*
+ * Dense numbering of the basic blocks of a function and of the instructions tracked by a dataflow problem.
+ * Tracked loads or stores are also indexed by the location (alloca) they access.
+ */
+struct DataflowNumbering {
+    std::vector<LLVMBasicBlockRef> blocks;
+    std::unordered_map<LLVMBasicBlockRef, size_t> block_num;
+    std::vector<std::vector<size_t>> preds;
+    std::vector<std::vector<size_t>> succs;
+    std::vector<LLVMValueRef> instrs;
+    std::unordered_map<LLVMValueRef, size_t> instr_num;
+    std::unordered_map<LLVMValueRef, std::vector<size_t>> by_location;
+};
+
+/*
+ * Solution of a load/store dataflow problem: IN and OUT sets indexed by block number.
+ */
+struct MemoryDataflow {
+    DataflowNumbering num;
+    std::vector<BitVector> in;
+    std::vector<BitVector> out;
+};
+
+/*
+ * Dominator tree over the reachable basic blocks of a function.
+ * Each block gets preorder and postorder numbers from a depth-first walk of the tree, so that
+ * a dominates b exactly when a's interval [pre, post] contains b's.
+ */
+class DomTree {
+public:
+    DomTree(void);
+    DomTree(const std::vector<LLVMBasicBlockRef>& rpo, const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& idoms);
+
+    LLVMBasicBlockRef get_root(void) const;
+    LLVMBasicBlockRef get_idom(LLVMBasicBlockRef bb) const;
+    const std::vector<LLVMBasicBlockRef>& get_children(LLVMBasicBlockRef bb) const;
+    const std::vector<LLVMBasicBlockRef>& get_preorder(void) const;
+
+    bool contains(LLVMBasicBlockRef bb) const;
+    bool dominates(LLVMBasicBlockRef a, LLVMBasicBlockRef b) const;
+
+private:
+    LLVMBasicBlockRef root;
+    std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> idom;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> children;
+    std::unordered_map<LLVMBasicBlockRef, std::pair<size_t, size_t>> dfs_num;
+    std::vector<LLVMBasicBlockRef> preorder;
+    std::vector<LLVMBasicBlockRef> no_children;
+};
+
+/*
+ * Natural loop of a back edge (or of all back edges to the same header).
+ */
+struct Loop {
+    LLVMBasicBlockRef header;
+    LLVMBasicBlockRef preheader;
+    std::vector<LLVMBasicBlockRef> latches;
+    std::vector<LLVMBasicBlockRef> blocks;
+    std::unordered_set<LLVMBasicBlockRef> block_set;
+    size_t depth;
+};
+
+/*
+ * Basic induction variable: a header phi that starts at init on entry and is advanced by a constant step on the back edge.
+ */
+struct InductionVariable {
+    LLVMValueRef phi;
+    LLVMValueRef init;
+    LLVMValueRef update;
+    long long step;
+};
+
+class AnalysisManager {
+public:
+    AnalysisManager(void);
+
+    const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& get_preds(LLVMValueRef f);
+    const std::vector<LLVMBasicBlockRef>& get_rpo(LLVMValueRef f);
+    const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& get_idoms(LLVMValueRef f);
+    const DomTree& get_dom_tree(LLVMValueRef f);
+    const std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>& get_dominance_frontiers(LLVMValueRef f);
+    const std::vector<Loop>& get_loops(LLVMValueRef f);
+    const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& get_post_idoms(LLVMValueRef f);
+    const std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>& get_post_dominance_frontiers(LLVMValueRef f);
+    const MemoryDataflow* get_reaching_stores(LLVMValueRef f);
+    const MemoryDataflow* get_live_loads(LLVMValueRef f);
+
+    void invalidate(LLVMValueRef f, unsigned preserved);
+    void clear(void);
+
+    size_t get_dataflow_visits(void) const;
+    size_t get_num_reused(void) const;
+
+private:
+    struct FunctionAnalyses {
+        std::optional<std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>> preds;
+        std::optional<std::vector<LLVMBasicBlockRef>> rpo;
+        std::optional<std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>> idoms;
+        std::optional<DomTree> dom_tree;
+        std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>> dominance_frontiers;
+        std::optional<std::vector<Loop>> loops;
+        std::optional<std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>> post_idoms;
+        std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>> post_dominance_frontiers;
+        std::optional<MemoryDataflow> reaching_stores;
+        std::optional<MemoryDataflow> live_loads;
+    };
+
+    std::unordered_map<LLVMValueRef, FunctionAnalyses> cache;
+    size_t dataflow_visits;
+    size_t num_reused;
+};
+
+std::vector<LLVMBasicBlockRef> get_successors(LLVMBasicBlockRef bb);
+
+std::vector<InductionVariable> find_induction_variables(const Loop& loop);
+
+DataflowNumbering number_function(LLVMValueRef f, LLVMOpcode op);
+
+std::vector<size_t> find_instrs_with_operand(const BitVector& set, const DataflowNumbering& num, LLVMValueRef operand);
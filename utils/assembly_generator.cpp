@@ -8,473 +8,1320 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <queue>
 #include <unordered_set>
 #include "assembly_generator.h"
+#include "analysis_manager.h"
+#include "dataflow.h"
 #include <vector>
 #include <format>
 
-#define NUM_REGS 3
+#define NUM_REGS 6
+#define EAX_REG 5
 
-static int get_num_uses(LLVMBasicBlockRef bb, LLVMValueRef inst) {
-    LLVMUseRef use;
-    int num_uses;
+// Order in which free registers are tried: caller-saved first for values that do not live across a call,
+// callee-saved first for values that do, since those survive calls without being saved around each one.
+static const int default_order[] = {1, 2, 0, 3, 4};
+static const int call_crossing_order[] = {0, 3, 4, 1, 2};
 
-    if (bb == NULL || inst == NULL) {
-        std::cerr << "Inavlid argument(s) to function.\n";
-        return -1;
-    }
+/*
+ * Part of a value's lifetime spent in one register, as an inclusive range of positions.
+ */
+struct LiveRange {
+    int start;
+    int end;
+    int reg;
+};
+
+/*
+ * Live interval waiting to be allocated: the rest of a value's lifetime from start to end, with the positions of the instructions that read it
+ * and the weight of each read. Its cost is the weight of the reads left, including phi operands it feeds, that would have to come from memory.
+ */
+struct Interval {
+    LLVMValueRef value;
+    int start;
+    int end;
+    std::vector<int> uses;
+    std::vector<double> weights;
+    double cost;
+};
 
-    // Find first use of instruction in basic block.
-    if ((use = LLVMGetFirstUse(inst)) == NULL)
-        return 0;
+/*
+ * Orders the unhandled intervals of linear scan by start position.
+ */
+struct IntervalLater {
+    bool operator()(const Interval& a, const Interval& b) const { return a.start > b.start; }
+};
 
-    num_uses = 1;
+/*
+ * Values that may be given a register, numbered densely, and the sets of them live into and out of each block.
+ */
+struct Liveness {
+    std::vector<LLVMValueRef> values;
+    std::unordered_map<LLVMValueRef, size_t> value_num;
+    std::vector<LLVMBasicBlockRef> blocks;
+    std::vector<BitVector> live_in;
+    std::vector<BitVector> live_out;
+};
 
-    // Walk through all instructions in basic block.
-    while (use != NULL && LLVMGetInstructionParent(LLVMGetUser(use)) == bb) {
-        use = LLVMGetNextUse(use);
-        num_uses++;
-    }
+/*
+ * Register allocation of a whole function.
+ * Blocks are laid out in program order and non-alloca instruction k gets position 2k: its operands are read at 2k and its result written at 2k + 1.
+ * Phis are written at the start of their block and read their incoming values at the end of the predecessor.
+ * At any position outside its register ranges, a value is in its stack slot.
+ */
+struct RegAllocation {
+    std::unordered_map<LLVMValueRef, int> position;
+    std::unordered_map<LLVMBasicBlockRef, std::pair<int, int>> block_range;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMValueRef>> live_in;
+    std::unordered_map<LLVMValueRef, std::vector<LiveRange>> ranges;
+    std::unordered_map<int, std::vector<std::pair<LLVMValueRef, int>>> reloads;
+    std::unordered_set<LLVMValueRef> spilled;
+    std::unordered_map<LLVMValueRef, std::vector<LLVMValueRef>> live_across_calls;
+    std::unordered_set<LLVMValueRef> crosses_call;
+};
 
-    return num_uses;
+/*
+ * Finds the function with a body in a module.
+ * There will only be one function with a body; the others are declarations of print and read.
+ *
+ * Args:
+ * - m: module to search.
+ *
+ * Returns:
+ * - Function with a body, nullopt if there is none.
+ */
+static std::optional<LLVMValueRef> find_function_body(LLVMModuleRef m) {
+    LLVMValueRef f;
+
+    for (f = LLVMGetFirstFunction(m); f != NULL; f = LLVMGetNextFunction(f))
+        if (LLVMGetFirstBasicBlock(f) != NULL) return f;
+
+    std::cerr << "Could not find function ref.\n";
+    return std::nullopt;
 }
 
-static LLVMValueRef get_last_use(LLVMBasicBlockRef bb, LLVMValueRef inst) {
-    LLVMValueRef i;
-    int j;
-    bool used;
+static std::optional<std::unordered_map<LLVMBasicBlockRef, std::string>> create_bb_labels(LLVMValueRef f) {
+    LLVMBasicBlockRef bb;
+    std::unordered_map<LLVMBasicBlockRef, std::string> labels;
+    int num;
+    std::string name;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return std::nullopt;
+    }
 
-    if (bb == NULL || inst == NULL) {
-        std::cerr << "Inavlid argument(s) to function.\n";
-        return NULL;
+    num = 0;
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        name = std::string("BB") + std::to_string(num);
+        labels[bb] = name;
+        num++;
     }
 
-    if (get_num_uses(bb, inst) == 0)
-        return inst;
+    return labels;
+}
 
-    used = false;
-    // Loop through basic block from bottom to find last use of instruction.
-    for (i = LLVMGetLastInstruction(bb); i != inst && i != NULL && !used; i = LLVMGetPreviousInstruction(i)) {
-        for (j = 0; j < LLVMGetNumOperands(i) && !used; j++) {
-            if (LLVMGetOperand(i, j) == inst)
-                used = true;
-        }
+static int print_directives(std::ofstream& ofile) {
+    if (!ofile.is_open()) {
+        std::cerr << "File not open.\n";
+        return -1;
     }
 
-    return LLVMGetNextInstruction(i);
+    ofile << "\t.text\n";
+    ofile << "\t.globl func\n";
+    ofile << "\t.type func, @function\n";
+    ofile << "func:\n";
+
+    return 0;
 }
 
-static std::optional<std::unordered_map<LLVMValueRef, int>> get_inst_index(LLVMBasicBlockRef bb) {
-    std::unordered_map<LLVMValueRef, int> inst_index;
+static int print_function_end(std::ofstream& ofile) {
+    if (!ofile.is_open()) {
+        std::cerr << "File not open.\n";
+        return -1;
+    }
+
+    ofile << "\tleave\n";
+    ofile << "\tret\n";
+
+    return 0;
+}
+static bool has_phis(LLVMBasicBlockRef bb) {
     LLVMValueRef i;
-    int inst_num;
 
-    // Check argument.
-    if (bb == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
-    }
+    return (i = LLVMGetFirstInstruction(bb)) != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI;
+}
 
-    // Map each instruction to index.
-    inst_num = 0;
-    for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-        // Ignore alloca instructions.
-        if (LLVMGetInstructionOpcode(i) != LLVMAlloca) {
-            inst_index[i] = inst_num;
-            inst_num++;
-        }
+/*
+ * Gets the x86 condition code suffix for an integer comparison predicate.
+ *
+ * Args:
+ * - pred: comparison predicate.
+ *
+ * Returns:
+ * - Suffix for jcc/setcc, nullopt for unsupported predicates.
+ */
+static std::optional<std::string> get_condition_code(LLVMIntPredicate pred) {
+    switch (pred) {
+        case LLVMIntEQ:
+            return std::string("e");
+        case LLVMIntNE:
+            return std::string("ne");
+        case LLVMIntSGT:
+            return std::string("g");
+        case LLVMIntSGE:
+            return std::string("ge");
+        case LLVMIntSLT:
+            return std::string("l");
+        case LLVMIntSLE:
+            return std::string("le");
+        default:
+            std::cerr << "Unknown predicate.\n";
+            return std::nullopt;
     }
+}
+
+/*
+ * Checks whether a comparison only feeds the conditional branch directly after it.
+ * Such a comparison leaves its result in the flags; any other comparison must materialize its result as 0 or 1.
+ */
+static bool is_fused_compare(LLVMValueRef icmp) {
+    LLVMUseRef use;
+    LLVMValueRef next;
 
-    return inst_index;
+    if (LLVMGetInstructionOpcode(icmp) != LLVMICmp || (use = LLVMGetFirstUse(icmp)) == NULL || LLVMGetNextUse(use) != NULL) return false;
+
+    next = LLVMGetNextInstruction(icmp);
+    return next != NULL && LLVMGetUser(use) == next && LLVMGetInstructionOpcode(next) == LLVMBr;
 }
 
-static std::optional<std::unordered_map<LLVMValueRef, std::pair<int, int>>> get_live_range(LLVMBasicBlockRef bb, std::unordered_map<LLVMValueRef, int> inst_index) {
-    LLVMValueRef i, last_use;
-    std::unordered_map<LLVMValueRef, std::pair<int, int>> live_range;
+static std::optional<std::unordered_map<LLVMValueRef, int>> get_offset_map(LLVMValueRef f, int& local_mem) {
+    std::unordered_map<LLVMValueRef, int> offset_map;
+    LLVMValueRef param, i;
+    LLVMBasicBlockRef bb;
+    LLVMOpcode op;
 
-    // Check arguments.
-    if (bb == NULL) {
-        std::cerr << "Invalid argument to function.\n";
+    if (f == NULL) {
+        std::cerr << "Invalid argument to funcion.\n";
         return std::nullopt;
     }
 
-    // Get live range for each relevant instruction.
-    for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-        // Only deal with instructions which have a left hand side.
-        if (LLVMGetInstructionOpcode(i) != LLVMAlloca && LLVMGetTypeKind(LLVMTypeOf(i)) != LLVMVoidTypeKind) {
-            if ((last_use = get_last_use(bb, i)) == NULL) {
-                std::cerr << "Failed to find last use.\n";
-                return std::nullopt;
+    local_mem = 4;
+
+    // Add parameter to offset map.
+    if ((param = LLVMGetFirstParam(f)) != NULL)
+        offset_map[param] = 8;
+
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            op = LLVMGetInstructionOpcode(i);
+            // Add alloca instructions to offset map.
+            if (op == LLVMAlloca) {
+                // NB: Added 4 after adding here (differs from algorithm).
+                offset_map[i] = -local_mem;
+                local_mem += 4;
             }
+            else if (op == LLVMStore && param != NULL && LLVMGetOperand(i, 0) == param)
+                offset_map[LLVMGetOperand(i, 1)] = offset_map[param];
+        }
+    }
 
-            live_range[i] = std::make_pair(inst_index[i], inst_index[last_use]);
+    // Give every other value its own slot: a split value is stored there at its definition and reloaded from it later,
+    // so the slot must not be shared with a variable that may be overwritten in between.
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (LLVMGetTypeKind(LLVMTypeOf(i)) != LLVMVoidTypeKind && !offset_map.contains(i)) {
+                offset_map[i] = -local_mem;
+                local_mem += 4;
+            }
         }
     }
 
-    return live_range;
+    return offset_map;
+}
+
+/*
+ * Checks whether a value can be kept in a register: a non-alloca instruction with a result.
+ */
+static bool is_allocatable(LLVMValueRef v) {
+    return LLVMIsAInstruction(v) != NULL && LLVMGetInstructionOpcode(v) != LLVMAlloca && LLVMGetTypeKind(LLVMTypeOf(v)) != LLVMVoidTypeKind;
 }
 
-static std::optional<LLVMValueRef> find_spills(LLVMValueRef inst, std::unordered_map<LLVMValueRef, int> reg_map, std::unordered_map<LLVMValueRef, int> inst_index, std::vector<LLVMValueRef> sorted_list, std::unordered_map<LLVMValueRef, std::pair<int, int>> live_range) {
-    std::vector<LLVMValueRef>::iterator it;
-    int vo, vc, io, ic;
+/*
+ * Gets the value a phi takes when control arrives from a predecessor.
+ *
+ * Returns:
+ * - Incoming value, NULL if the phi has none for the predecessor.
+ */
+static LLVMValueRef get_incoming_value(LLVMValueRef phi, LLVMBasicBlockRef pred) {
+    unsigned int k;
 
-    // Check arguments.
-    if (inst == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
-    }
+    for (k = 0; k < LLVMCountIncoming(phi); k++)
+        if (LLVMGetIncomingBlock(phi, k) == pred) return LLVMGetIncomingValue(phi, k);
 
-    io = live_range[inst].first;
-    ic = live_range[inst].second;
+    return NULL;
+}
 
-    // Check through every instruction in sorted list.
-    for (it = sorted_list.begin(); it != sorted_list.end(); it++) {
-        // See if instruction has overlapping liveness with instuction.
-        vo = live_range[*it].first;
-        vc = live_range[*it].second;
-        if (!(vc < io || ic < vo) && reg_map.contains(*it) && reg_map[*it] != -1)
-            return *it;
-    }
+/*
+ * Checks whether a value is the first operand of an instruction computed as "movl op1, r; op op2, r".
+ * The first operand is dead once copied, so its register may be reused for the result unless it is also the second operand.
+ */
+static bool is_two_address_operand(LLVMValueRef user, LLVMValueRef v) {
+    LLVMOpcode op;
 
-    return std::nullopt;
+    op = LLVMGetInstructionOpcode(user);
+    if (op != LLVMAdd && op != LLVMSub && op != LLVMMul && op != LLVMAnd && op != LLVMShl && op != LLVMLShr && op != LLVMICmp) return false;
+
+    return LLVMGetOperand(user, 0) == v && LLVMGetOperand(user, 1) != v;
 }
-static std::optional<std::unordered_map<LLVMValueRef, int>> get_num_uses_map(LLVMBasicBlockRef bb) {
-    std::unordered_map<LLVMValueRef, int> map;
-    LLVMValueRef i;
 
-    if (bb == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
-    }
+/*
+ * Checks whether a value may be kept in %eax, which code generation also uses as scratch: for results written to memory,
+ * memory-to-memory moves, setcc and call results. That is only safe for a value read once, by the instruction right after
+ * its definition, and not as the second operand of a two-address instruction, whose result may be computed in %eax first.
+ */
+static bool is_eax_candidate(LLVMValueRef v) {
+    LLVMUseRef use;
+    LLVMValueRef user;
 
-    for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-        // Only consider non-alloca instructions with return values.
-        if (LLVMGetInstructionOpcode(i) != LLVMAlloca && LLVMGetTypeKind(LLVMTypeOf(i)) != LLVMVoidTypeKind) {
-            if ((map[i] = get_num_uses(bb, i)) == -1) {
-                std::cerr << "Failed to get number of uses.\n";
-                return std::nullopt;
-            }
-        }
-    }
+    if (LLVMGetInstructionOpcode(v) == LLVMPHI || (use = LLVMGetFirstUse(v)) == NULL || LLVMGetNextUse(use) != NULL) return false;
 
-    return map;
+    user = LLVMGetUser(use);
+    if (user != LLVMGetNextInstruction(v) || LLVMGetInstructionOpcode(user) == LLVMPHI) return false;
+
+    return !is_two_address_operand(user, LLVMGetOperand(user, 0)) || LLVMGetOperand(user, 1) != v;
 }
 
-static std::vector<LLVMValueRef> get_sorted_list(std::unordered_map<LLVMValueRef, int> num_uses_map) {
-    std::vector<LLVMValueRef> sorted_list;
-    LLVMValueRef min_ref;
-    std::unordered_map<LLVMValueRef, int>::iterator map_it;
-    int min;
+/*
+ * Gets the position at which a value is written.
+ */
+static int get_def_position(const RegAllocation& ra, LLVMValueRef v) {
+    if (LLVMGetInstructionOpcode(v) == LLVMPHI) return ra.block_range.at(LLVMGetInstructionParent(v)).first;
+    return ra.position.at(v) + 1;
+}
 
-    while (!num_uses_map.empty()) {
-        // Find minimum number of uses currently in map.
-        for (map_it = num_uses_map.begin(); map_it != num_uses_map.end(); map_it++) {
-            if (map_it == num_uses_map.begin()) {
-                min = map_it->second;
-                min_ref = map_it->first;
-            } else if (map_it->second < min) {
-                min = map_it->second;
-                min_ref = map_it->first;
+/*
+ * Numbers the non-alloca instructions of a function in layout order and records the first and last position of each block.
+ */
+static void number_positions(LLVMValueRef f, RegAllocation& ra) {
+    LLVMBasicBlockRef bb;
+    LLVMValueRef i;
+    int pos, start;
+
+    pos = 0;
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        start = pos;
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (LLVMGetInstructionOpcode(i) != LLVMAlloca) {
+                ra.position[i] = pos;
+                pos += 2;
             }
         }
 
-        // Remove minimum element from map and add into sorted list.
-        num_uses_map.erase(min_ref);
-        sorted_list.push_back(min_ref);
+        // The block ends just after its terminator reads its operands.
+        ra.block_range[bb] = std::make_pair(start, pos - 1);
     }
-
-    return sorted_list;
 }
 
-static std::optional<std::unordered_map<LLVMBasicBlockRef, std::string>> create_bb_labels(LLVMModuleRef m) {
+/*
+ * Computes liveness over the whole function.
+ * Phi operands are treated as read at the end of the predecessor they come from, so they are live out of it but not into the phi's block.
+ *
+ * Args:
+ * - f: function to analyze.
+ * - ra: allocation with positions already numbered; the values live into each block and the values live across each call are recorded in it.
+ *
+ * Returns:
+ * - Values that may be given a register and the blocks they are live into and out of, nullopt on failure.
+ */
+static std::optional<Liveness> compute_liveness(LLVMValueRef f, RegAllocation& ra) {
+    DataflowNumbering num;
+    Liveness lv;
+    std::vector<BitVector> gen, kill;
+    BitVector live_after;
+    std::vector<LLVMBasicBlockRef> succs;
+    std::vector<LLVMBasicBlockRef>::iterator succ_it;
     LLVMBasicBlockRef bb;
-    LLVMValueRef f;
-    std::unordered_map<LLVMBasicBlockRef, std::string> labels;
-    int num;
-    std::string name;
+    LLVMValueRef i, operand, phi;
+    size_t b, v;
+    int j;
 
-    if (m == NULL) {
+    if (f == NULL) {
         std::cerr << "Invalid argument to function.\n";
         return std::nullopt;
     }
 
-    // There will only be one function with a body.
-    if ((f = LLVMGetFirstFunction(m)) == NULL) {
-        std::cerr << "Could not find function ref.\n";
-        return std::nullopt;
+    num = number_function(f, LLVMLoad);
+    lv.blocks = num.blocks;
+
+    // Number the values that may be given a register.
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (is_allocatable(i)) {
+                lv.value_num[i] = lv.values.size();
+                lv.values.push_back(i);
+            }
+        }
     }
 
-    while (LLVMGetFirstBasicBlock(f) == NULL) {
-        if ((f = LLVMGetNextFunction(f)) == NULL) {
-            std::cerr << "Could not find function ref.\n";
-            return std::nullopt;
+    gen.assign(num.blocks.size(), BitVector(lv.values.size()));
+    kill.assign(num.blocks.size(), BitVector(lv.values.size()));
+    lv.live_out.assign(num.blocks.size(), BitVector(lv.values.size()));
+
+    for (b = 0; b < num.blocks.size(); b++) {
+        bb = num.blocks[b];
+
+        // Values read in a block before being defined there are live into it; values defined there are killed.
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (LLVMGetInstructionOpcode(i) != LLVMPHI) {
+                for (j = 0; j < LLVMGetNumOperands(i); j++) {
+                    operand = LLVMGetOperand(i, j);
+                    if (lv.value_num.contains(operand) && LLVMGetInstructionParent(operand) != bb)
+                        gen[b].set(lv.value_num[operand]);
+                }
+            }
+
+            if (lv.value_num.contains(i))
+                kill[b].set(lv.value_num[i]);
+        }
+
+        // Phi operands are read at the end of the predecessor they come from.
+        succs = get_successors(bb);
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it) {
+            for (phi = LLVMGetFirstInstruction(*succ_it); phi != NULL && LLVMGetInstructionOpcode(phi) == LLVMPHI; phi = LLVMGetNextInstruction(phi)) {
+                operand = get_incoming_value(phi, bb);
+                if (operand != NULL && lv.value_num.contains(operand)) {
+                    lv.live_out[b].set(lv.value_num[operand]);
+                    if (LLVMGetInstructionParent(operand) != bb)
+                        gen[b].set(lv.value_num[operand]);
+                }
+            }
         }
     }
 
-    num = 0;
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        name = std::string("BB") + std::to_string(num);
-        labels[bb] = name;
-        num++;
+    Dataflow<Direction::Backward, BitVector, GenKillTransfer, UnionMeet> live(num.preds, num.succs, BitVector(lv.values.size()), BitVector(lv.values.size()), GenKillTransfer{gen, kill}, UnionMeet{});
+    live.solve();
+
+    lv.live_in = live.get_in();
+    for (b = 0; b < num.blocks.size(); b++) {
+        lv.live_out[b].union_with(live.get_out()[b]);
+        for (v = lv.live_in[b].find_first(); v < lv.values.size(); v = lv.live_in[b].find_next(v + 1))
+            ra.live_in[num.blocks[b]].push_back(lv.values[v]);
+
+        // Walk the block backwards to find the values still needed after each call.
+        live_after = lv.live_out[b];
+        for (i = LLVMGetLastInstruction(num.blocks[b]); i != NULL && LLVMGetInstructionOpcode(i) != LLVMPHI; i = LLVMGetPreviousInstruction(i)) {
+            if (lv.value_num.contains(i))
+                live_after.reset(lv.value_num[i]);
+
+            if (LLVMGetInstructionOpcode(i) == LLVMCall) {
+                ra.live_across_calls[i].clear();
+                for (v = live_after.find_first(); v < lv.values.size(); v = live_after.find_next(v + 1)) {
+                    ra.live_across_calls[i].push_back(lv.values[v]);
+                    ra.crosses_call.insert(lv.values[v]);
+                }
+            }
+
+            for (j = 0; j < LLVMGetNumOperands(i); j++)
+                if (lv.value_num.contains(operand = LLVMGetOperand(i, j)))
+                    live_after.set(lv.value_num[operand]);
+        }
     }
 
-    return labels;
+    return lv;
 }
 
-static int print_directives(std::ofstream& ofile) {
-    if (!ofile.is_open()) {
-        std::cerr << "File not open.\n";
-        return -1;
-    }
+/*
+ * Gets the loop nesting depth of each block of a function; blocks outside loops are absent.
+ */
+static std::unordered_map<LLVMBasicBlockRef, size_t> get_loop_depths(LLVMValueRef f) {
+    AnalysisManager am;
+    const std::vector<Loop>* loops;
+    std::vector<Loop>::const_iterator loop_it;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::unordered_map<LLVMBasicBlockRef, size_t> depths;
+
+    loops = &am.get_loops(f);
+    for (loop_it = loops->begin(); loop_it != loops->end(); ++loop_it)
+        for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end(); ++bb_it)
+            depths[*bb_it] = std::max(depths[*bb_it], loop_it->depth);
+
+    return depths;
+}
 
-    ofile << "\t.text\n";
-    ofile << "\t.globl func\n";
-    ofile << "\t.type func, @function\n";
-    ofile << "func:\n";
+/*
+ * Estimates how often a block runs: 10 to the power of its loop depth.
+ */
+static double get_block_weight(const std::unordered_map<LLVMBasicBlockRef, size_t>& depths, LLVMBasicBlockRef bb) {
+    std::unordered_map<LLVMBasicBlockRef, size_t>::const_iterator it;
 
-    return 0;
+    if ((it = depths.find(bb)) == depths.end()) return 1.0;
+    return std::pow(10.0, (double)std::min(it->second, (size_t)6));
 }
 
-static int print_function_end(std::ofstream& ofile) {
-    if (!ofile.is_open()) {
-        std::cerr << "File not open.\n";
-        return -1;
+/*
+ * Builds one live interval per value.
+ * A value's interval runs from its definition to its last use in layout order and covers every block it is live into or out of,
+ * so values stay available across branches and loop back edges. Each read is weighted by the loop depth of the block it runs in.
+ *
+ * Args:
+ * - lv: liveness of the function.
+ * - ra: allocation with positions already numbered.
+ * - depths: loop nesting depth of each block.
+ *
+ * Returns:
+ * - Interval of each value.
+ */
+static std::vector<Interval> build_intervals(const Liveness& lv, RegAllocation& ra, const std::unordered_map<LLVMBasicBlockRef, size_t>& depths) {
+    std::vector<Interval> intervals;
+    Interval interval;
+    std::vector<std::pair<int, double>> reads;
+    std::vector<std::pair<int, double>>::iterator read_it;
+    LLVMBasicBlockRef bb;
+    LLVMValueRef i, user;
+    LLVMUseRef use;
+    size_t b, v;
+    unsigned int k;
+    int pos;
+
+    for (v = 0; v < lv.values.size(); v++) {
+        i = lv.values[v];
+        interval.value = i;
+        interval.start = get_def_position(ra, i);
+        interval.end = interval.start;
+        interval.cost = 0.0;
+        reads.clear();
+
+        // Phi uses are covered by the value being live out of the predecessor, and only add to the cost.
+        for (use = LLVMGetFirstUse(i); use != NULL; use = LLVMGetNextUse(use)) {
+            user = LLVMGetUser(use);
+            if (LLVMGetInstructionOpcode(user) != LLVMPHI) {
+                pos = ra.position[user];
+                reads.push_back(std::make_pair(pos, get_block_weight(depths, LLVMGetInstructionParent(user))));
+                interval.end = std::max(interval.end, is_two_address_operand(user, i) ? pos : pos + 1);
+            } else {
+                for (k = 0; k < LLVMCountIncoming(user); k++)
+                    if (LLVMGetOperandUse(user, k) == use)
+                        interval.cost += get_block_weight(depths, LLVMGetIncomingBlock(user, k));
+            }
+        }
+
+        for (b = 0; b < lv.blocks.size(); b++) {
+            bb = lv.blocks[b];
+            if (lv.live_in[b].test(v)) {
+                interval.start = std::min(interval.start, ra.block_range[bb].first);
+                interval.end = std::max(interval.end, ra.block_range[bb].first);
+            }
+            if (lv.live_out[b].test(v)) {
+                interval.end = std::max(interval.end, ra.block_range[bb].second);
+                if (LLVMGetInstructionParent(i) != bb)
+                    interval.start = std::min(interval.start, ra.block_range[bb].first);
+            }
+        }
+
+        std::sort(reads.begin(), reads.end());
+        interval.uses.clear();
+        interval.weights.clear();
+        for (read_it = reads.begin(); read_it != reads.end(); ++read_it) {
+            interval.uses.push_back(read_it->first);
+            interval.weights.push_back(read_it->second);
+            interval.cost += read_it->second;
+        }
+
+        intervals.push_back(interval);
     }
 
-    ofile << "\tleave\n";
-    ofile << "\tret\n";
+    return intervals;
+}
 
-    return 0;
+/*
+ * Picks a free register other than %eax.
+ *
+ * Args:
+ * - avail: whether each register is free.
+ * - crosses_call: whether the value lives across a call, so that callee-saved registers are tried first.
+ *
+ * Returns:
+ * - Register number, NUM_REGS if none is free.
+ */
+static int pick_register(const bool avail[NUM_REGS], bool crosses_call) {
+    const int* order;
+    int k;
+
+    order = crosses_call ? call_crossing_order : default_order;
+    for (k = 0; k < NUM_REGS - 1; k++)
+        if (avail[order[k]]) return order[k];
+
+    return NUM_REGS;
 }
 
-static std::optional<std::unordered_map<LLVMValueRef, int>> get_offset_map(LLVMModuleRef m, int& local_mem) {
-    std::unordered_map<LLVMValueRef, int> offset_map;
-    LLVMValueRef f, param, i;
-    LLVMBasicBlockRef bb;
-    LLVMOpcode op;
+/*
+ * Finds the first use of an interval at or after a position.
+ *
+ * Returns:
+ * - Position of the use, INT_MAX if the value is not read again.
+ */
+static int get_next_use(const Interval& interval, int pos) {
+    std::vector<int>::const_iterator it;
 
-    if (m == NULL) {
-        std::cerr << "Invalid argument to funcion.\n";
+    it = std::lower_bound(interval.uses.begin(), interval.uses.end(), pos);
+    return it == interval.uses.end() ? INT_MAX : *it;
+}
+
+/*
+ * Requeues the rest of an interval from its first use at or after a position, so that it is reloaded just before that use.
+ * Nothing is requeued if the value is not read again.
+ */
+static void split_interval(const Interval& interval, int pos, std::priority_queue<Interval, std::vector<Interval>, IntervalLater>& unhandled) {
+    std::vector<int>::const_iterator it;
+    Interval child;
+    size_t first, k;
+
+    if ((it = std::lower_bound(interval.uses.begin(), interval.uses.end(), pos)) == interval.uses.end()) return;
+    first = it - interval.uses.begin();
+
+    child.value = interval.value;
+    child.start = *it;
+    child.end = interval.end;
+    child.uses.assign(it, interval.uses.end());
+    child.weights.assign(interval.weights.begin() + first, interval.weights.end());
+
+    // Reads before the split point no longer count.
+    child.cost = interval.cost;
+    for (k = 0; k < first; k++)
+        child.cost -= interval.weights[k];
+
+    unhandled.push(std::move(child));
+}
+
+/*
+ * Checks whether interval a is a better choice than interval b to go to memory at a position: it costs less to keep there,
+ * or as much but is read later.
+ */
+static bool is_cheaper_spill(const Interval& a, const Interval& b, int pos) {
+    if (a.cost != b.cost) return a.cost < b.cost;
+    return get_next_use(a, pos) > get_next_use(b, pos);
+}
+
+/*
+ * Allocates registers for a whole function by linear scan over its live intervals.
+ * When no register is free, the interval with the lowest loop-weighted cost of the reads it has left is split, the one read furthest
+ * away among equals: it keeps its register up to that point, waits in its stack slot, and is requeued from its next use.
+ * Split values are stored to their slot when defined.
+ *
+ * Args:
+ * - f: function to allocate.
+ *
+ * Returns:
+ * - Allocation of the function, nullopt on failure.
+ */
+static std::optional<RegAllocation> allocate_registers(LLVMValueRef f) {
+    RegAllocation ra;
+    std::optional<Liveness> lv_opt;
+    std::vector<Interval> intervals;
+    std::vector<Interval>::iterator int_it;
+    std::priority_queue<Interval, std::vector<Interval>, IntervalLater> unhandled;
+    std::vector<std::pair<Interval, int>> active;
+    std::vector<std::pair<Interval, int>>::iterator act_it, victim_it;
+    std::unordered_map<LLVMValueRef, std::vector<LiveRange>>::iterator range_it;
+    std::vector<LiveRange>::iterator piece_it;
+    Interval current;
+    bool free_regs[NUM_REGS];
+    int r, end;
+
+    // Check argument.
+    if (f == NULL) {
+        std::cerr << "Invlaid argument to function.\n";
         return std::nullopt;
     }
 
-    // There will only be one function with a body.
-    if ((f = LLVMGetFirstFunction(m)) == NULL) {
-        std::cerr << "Could not find function ref.\n";
+    number_positions(f, ra);
+
+    if (!(lv_opt = compute_liveness(f, ra)).has_value()) {
+        std::cerr << "Failed to compute liveness.\n";
         return std::nullopt;
     }
 
-    while (LLVMGetFirstBasicBlock(f) == NULL) {
-        if ((f = LLVMGetNextFunction(f)) == NULL) {
-            std::cerr << "Could not find function ref.\n";
-            return std::nullopt;
+    intervals = build_intervals(lv_opt.value(), ra, get_loop_depths(f));
+    for (int_it = intervals.begin(); int_it != intervals.end(); ++int_it)
+        unhandled.push(std::move(*int_it));
+
+    for (r = 0; r < NUM_REGS; r++)
+        free_regs[r] = true;
+
+    while (!unhandled.empty()) {
+        current = unhandled.top();
+        unhandled.pop();
+
+        // Free the registers of intervals that ended before this one starts.
+        for (act_it = active.begin(); act_it != active.end();) {
+            if (act_it->first.end < current.start) {
+                ra.ranges[act_it->first.value].push_back(LiveRange{act_it->first.start, act_it->first.end, act_it->second});
+                free_regs[act_it->second] = true;
+                act_it = active.erase(act_it);
+            } else
+                ++act_it;
+        }
+
+        // %eax is only offered to values that may live in it, and is their first choice.
+        if (is_eax_candidate(current.value) && free_regs[EAX_REG]) r = EAX_REG;
+        else r = pick_register(free_regs, ra.crosses_call.contains(current.value));
+
+        if (r < NUM_REGS) {
+            free_regs[r] = false;
+            active.push_back(std::make_pair(current, r));
+            continue;
+        }
+
+        // No register is free: the cheapest interval to keep in memory gives up its register.
+        // Intervals read at this position cannot give it up, which also guarantees progress.
+        victim_it = active.end();
+        for (act_it = active.begin(); act_it != active.end(); ++act_it) {
+            if ((act_it->second != EAX_REG || is_eax_candidate(current.value)) && get_next_use(act_it->first, current.start) > current.start
+                && (victim_it == active.end() || is_cheaper_spill(act_it->first, victim_it->first, current.start)))
+                victim_it = act_it;
+        }
+
+        if (victim_it == active.end() || !is_cheaper_spill(victim_it->first, current, current.start)) {
+            // Current interval waits in memory until its next use.
+            ra.spilled.insert(current.value);
+            split_interval(current, current.start + 1, unhandled);
+        } else {
+            // The victim keeps its register until before the instruction at which the current interval takes it over,
+            // since that instruction may still read the victim after writing its result.
+            r = victim_it->second;
+            end = current.start - 1 - current.start % 2;
+            if (end >= victim_it->first.start)
+                ra.ranges[victim_it->first.value].push_back(LiveRange{victim_it->first.start, end, r});
+            ra.spilled.insert(victim_it->first.value);
+            split_interval(victim_it->first, current.start, unhandled);
+
+            active.erase(victim_it);
+            active.push_back(std::make_pair(current, r));
         }
     }
 
-    local_mem = 4;
+    for (act_it = active.begin(); act_it != active.end(); ++act_it)
+        ra.ranges[act_it->first.value].push_back(LiveRange{act_it->first.start, act_it->first.end, act_it->second});
 
-    // Add parameter to offset map.
-    if ((param = LLVMGetFirstParam(f)) != NULL)
-        offset_map[param] = 8;
+    // Register ranges that do not start at the definition begin with a reload from the stack slot.
+    for (range_it = ra.ranges.begin(); range_it != ra.ranges.end(); ++range_it) {
+        for (piece_it = range_it->second.begin(); piece_it != range_it->second.end(); ++piece_it)
+            if (piece_it->start != get_def_position(ra, range_it->first))
+                ra.reloads[piece_it->start].push_back(std::make_pair(range_it->first, piece_it->reg));
+    }
+
+    return ra;
+}
+
+/*
+ * Computes the cost of keeping each value in memory: its definition and each of its uses, weighted by how often their block runs.
+ * Phi operands count as used at the end of the predecessor they come from.
+ *
+ * Args:
+ * - f: function the values belong to.
+ * - lv: liveness of the function, which numbers its values.
+ *
+ * Returns:
+ * - Spill cost of each value, indexed by value number.
+ */
+static std::vector<double> get_spill_costs(LLVMValueRef f, const Liveness& lv) {
+    std::unordered_map<LLVMBasicBlockRef, size_t> depths;
+    std::vector<double> cost;
+    LLVMBasicBlockRef bb;
+    LLVMValueRef i, operand;
+    unsigned int k;
+    int j;
+
+    depths = get_loop_depths(f);
+    cost.assign(lv.values.size(), 0.0);
 
     for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
         for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-            op = LLVMGetInstructionOpcode(i);
-            // Add alloca instructions to offset map.
-            if (op == LLVMAlloca) {
-                // NB: Added 4 after adding here (differs from algorithm).
-                offset_map[i] = -local_mem;
-                local_mem += 4;
-            }
-            else if (op == LLVMStore) {
-                if (param != NULL && LLVMGetOperand(i, 0) == param)
-                    offset_map[LLVMGetOperand(i, 1)] = offset_map[param];
-                else
-                    offset_map[LLVMGetOperand(i, 0)] = offset_map[LLVMGetOperand(i, 1)];
+            if (lv.value_num.contains(i))
+                cost[lv.value_num.at(i)] += get_block_weight(depths, bb);
+
+            if (LLVMGetInstructionOpcode(i) == LLVMPHI) {
+                for (k = 0; k < LLVMCountIncoming(i); k++)
+                    if (lv.value_num.contains(operand = LLVMGetIncomingValue(i, k)))
+                        cost[lv.value_num.at(operand)] += get_block_weight(depths, LLVMGetIncomingBlock(i, k));
+            } else {
+                for (j = 0; j < LLVMGetNumOperands(i); j++)
+                    if (lv.value_num.contains(operand = LLVMGetOperand(i, j)))
+                        cost[lv.value_num.at(operand)] += get_block_weight(depths, bb);
             }
-            else if (op == LLVMLoad)
-                offset_map[i] = offset_map[LLVMGetOperand(i, 0)];
         }
     }
 
-    return offset_map;
+    return cost;
+}
+
+/*
+ * Records that two values may not share a register.
+ */
+static void add_interference(std::vector<std::unordered_set<size_t>>& adj, size_t a, size_t b) {
+    if (a == b) return;
+
+    adj[a].insert(b);
+    adj[b].insert(a);
 }
 
-static std::optional<std::unordered_map<LLVMValueRef, int>> allocate_registers(LLVMModuleRef m) {
+/*
+ * Builds the interference graph of a function and collects the copies that coalescing may remove.
+ * A value interferes with every value live where it is defined; phis are defined together at the start of their block,
+ * so they interfere with each other and with the values live into the block. The result of a two-address instruction is
+ * written before its second operand is read, so it also interferes with that operand.
+ *
+ * Args:
+ * - lv: liveness of the function.
+ * - adj: set to the neighbors of each value, indexed by value number.
+ * - moves: set to the pairs of values joined by a copy: phis and their incoming values, two-address results and their first operand.
+ */
+static void build_interference_graph(const Liveness& lv, std::vector<std::unordered_set<size_t>>& adj, std::vector<std::pair<size_t, size_t>>& moves) {
+    BitVector live;
     LLVMBasicBlockRef bb;
-    LLVMValueRef inst, operand, v, f;
-    LLVMOpcode opcode;
-    std::unordered_set<int> avail_regs;
-    std::unordered_set<int>::iterator set_it;
-    std::unordered_map<LLVMValueRef, int> reg_map;
-    std::unordered_map<LLVMValueRef, int> inst_index;
-    std::optional<std::unordered_map<LLVMValueRef, int>> inst_index_opt;
-    std::optional<std::unordered_map<LLVMValueRef, std::pair<int, int>>> live_range_opt;
-    std::unordered_map<LLVMValueRef, std::pair<int, int>> live_range;
-    std::optional<LLVMValueRef> opt_v;
-    std::optional<std::unordered_map<LLVMValueRef, int>> num_uses_map_opt;
-    std::unordered_map<LLVMValueRef, int> num_uses_map;
-    std::vector<LLVMValueRef> sorted_list;
-    int i;
+    LLVMValueRef i, phi, operand;
+    size_t b, d, v;
+    unsigned int k;
+    int j;
+
+    adj.assign(lv.values.size(), std::unordered_set<size_t>());
+    moves.clear();
+
+    for (b = 0; b < lv.blocks.size(); b++) {
+        bb = lv.blocks[b];
+
+        // Walk the block backwards, keeping the set of values live after each instruction.
+        live = lv.live_out[b];
+        for (i = LLVMGetLastInstruction(bb); i != NULL && LLVMGetInstructionOpcode(i) != LLVMPHI; i = LLVMGetPreviousInstruction(i)) {
+            if (lv.value_num.contains(i)) {
+                d = lv.value_num.at(i);
+                for (v = live.find_first(); v < live.size(); v = live.find_next(v + 1))
+                    add_interference(adj, d, v);
+
+                if (is_two_address_operand(i, LLVMGetOperand(i, 0))) {
+                    if (lv.value_num.contains(LLVMGetOperand(i, 1)))
+                        add_interference(adj, d, lv.value_num.at(LLVMGetOperand(i, 1)));
+                    if (lv.value_num.contains(LLVMGetOperand(i, 0)))
+                        moves.push_back(std::make_pair(d, lv.value_num.at(LLVMGetOperand(i, 0))));
+                }
+
+                live.reset(d);
+            }
+
+            for (j = 0; j < LLVMGetNumOperands(i); j++)
+                if (lv.value_num.contains(operand = LLVMGetOperand(i, j)))
+                    live.set(lv.value_num.at(operand));
+        }
+
+        for (phi = LLVMGetFirstInstruction(bb); phi != NULL && LLVMGetInstructionOpcode(phi) == LLVMPHI; phi = LLVMGetNextInstruction(phi)) {
+            d = lv.value_num.at(phi);
+            for (v = live.find_first(); v < live.size(); v = live.find_next(v + 1))
+                add_interference(adj, d, v);
+            for (i = LLVMGetFirstInstruction(bb); i != phi; i = LLVMGetNextInstruction(i))
+                add_interference(adj, d, lv.value_num.at(i));
+
+            for (k = 0; k < LLVMCountIncoming(phi); k++)
+                if (lv.value_num.contains(operand = LLVMGetIncomingValue(phi, k)))
+                    moves.push_back(std::make_pair(d, lv.value_num.at(operand)));
+        }
+    }
+}
+
+/*
+ * Finds the node a value was coalesced into.
+ */
+static size_t find_alias(const std::vector<size_t>& alias, size_t v) {
+    while (alias[v] != v) v = alias[v];
+    return v;
+}
+
+/*
+ * Gets the number of registers a node may be colored with: all of them if every value in it may live in %eax, otherwise all but %eax.
+ */
+static size_t get_num_colors(const std::vector<bool>& eax_ok, size_t v) {
+    return eax_ok[v] ? NUM_REGS : NUM_REGS - 1;
+}
+
+/*
+ * Checks whether merging node a into node b keeps the graph colorable.
+ * Briggs: the merged node has fewer neighbors of significant degree than it has colors.
+ * George: every neighbor of a of significant degree already interferes with b (only if the merge leaves b's colors unchanged).
+ */
+static bool can_coalesce(const std::vector<std::unordered_set<size_t>>& adj, const std::vector<bool>& eax_ok, size_t a, size_t b) {
+    std::unordered_set<size_t> neighbors;
+    std::unordered_set<size_t>::const_iterator it;
+    size_t significant, colors;
+
+    neighbors = adj[a];
+    neighbors.insert(adj[b].begin(), adj[b].end());
+    colors = std::min(get_num_colors(eax_ok, a), get_num_colors(eax_ok, b));
+
+    significant = 0;
+    for (it = neighbors.begin(); it != neighbors.end(); ++it)
+        if (adj[*it].size() >= get_num_colors(eax_ok, *it)) significant++;
+
+    if (significant < colors) return true;
+    if (colors != get_num_colors(eax_ok, b)) return false;
+
+    for (it = adj[a].begin(); it != adj[a].end(); ++it)
+        if (adj[*it].size() >= get_num_colors(eax_ok, *it) && !adj[b].contains(*it)) return false;
+
+    return true;
+}
+
+/*
+ * Merges node a into node b: b takes over a's interferences and spill cost, and may use %eax only if both could.
+ */
+static void merge_nodes(std::vector<std::unordered_set<size_t>>& adj, std::vector<size_t>& alias, std::vector<double>& cost, std::vector<bool>& eax_ok, size_t a, size_t b) {
+    std::unordered_set<size_t>::iterator it;
+
+    for (it = adj[a].begin(); it != adj[a].end(); ++it) {
+        adj[*it].erase(a);
+        add_interference(adj, *it, b);
+    }
+
+    adj[a].clear();
+    alias[a] = b;
+    cost[b] += cost[a];
+    eax_ok[b] = eax_ok[b] && eax_ok[a];
+}
+
+/*
+ * Allocates registers for a whole function by Chaitin-Briggs graph coloring.
+ * Copies are coalesced while the conservative tests allow it. Nodes with fewer neighbors than colors are then removed first;
+ * when none is left, the node with the lowest spill cost per neighbor is removed optimistically. Nodes are colored in reverse
+ * order of removal, and a node left without a free color stays in its stack slot for its whole lifetime.
+ * Every instruction can read its operands from the stack, so spilled nodes need no spill code and the graph is built once.
+ *
+ * Args:
+ * - f: function to allocate.
+ *
+ * Returns:
+ * - Allocation of the function, nullopt on failure.
+ */
+static std::optional<RegAllocation> color_registers(LLVMValueRef f) {
+    RegAllocation ra;
+    std::optional<Liveness> lv_opt;
+    std::vector<std::unordered_set<size_t>> adj;
+    std::unordered_set<size_t>::iterator adj_it;
+    std::vector<std::pair<size_t, size_t>> moves;
+    std::vector<std::pair<size_t, size_t>>::iterator move_it;
+    std::vector<size_t> alias, degree, stack, low;
+    std::priority_queue<std::pair<double, size_t>, std::vector<std::pair<double, size_t>>, std::greater<std::pair<double, size_t>>> spill_queue;
+    std::vector<double> cost;
+    std::vector<bool> removed, eax_ok, crossing;
+    std::vector<int> color;
+    size_t n, v, a, b, best, remaining;
+    bool changed, stale, avail[NUM_REGS];
+    int r;
 
     // Check argument.
-    if (m == NULL) {
-        std::cerr << "Invlaid argument to function.\n";
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
         return std::nullopt;
     }
 
-    // There will only be one function with a body.
-    if ((f = LLVMGetFirstFunction(m)) == NULL) {
-        std::cerr << "Could not find function ref.\n";
+    number_positions(f, ra);
+
+    if (!(lv_opt = compute_liveness(f, ra)).has_value()) {
+        std::cerr << "Failed to compute liveness.\n";
         return std::nullopt;
     }
 
-    while (LLVMGetFirstBasicBlock(f) == NULL) {
-        if ((f = LLVMGetNextFunction(f)) == NULL) {
-            std::cerr << "Could not find function ref.\n";
-            return std::nullopt;
+    n = lv_opt.value().values.size();
+    build_interference_graph(lv_opt.value(), adj, moves);
+    cost = get_spill_costs(f, lv_opt.value());
+
+    // Coalesce copies until none passes the conservative tests.
+    for (v = 0; v < n; v++) {
+        alias.push_back(v);
+        eax_ok.push_back(is_eax_candidate(lv_opt.value().values[v]));
+        crossing.push_back(ra.crosses_call.contains(lv_opt.value().values[v]));
+    }
+
+    do {
+        changed = false;
+        for (move_it = moves.begin(); move_it != moves.end(); ++move_it) {
+            a = find_alias(alias, move_it->first);
+            b = find_alias(alias, move_it->second);
+            if (a != b && !adj[a].contains(b) && can_coalesce(adj, eax_ok, a, b)) {
+                merge_nodes(adj, alias, cost, eax_ok, a, b);
+                crossing[b] = crossing[b] || crossing[a];
+                changed = true;
+            }
         }
+    } while (changed);
+
+    // Simplify: remove nodes that are sure to get a color, otherwise the cheapest node to spill.
+    // Nodes of significant degree wait in a queue ordered by spill cost per neighbor; entries left behind when a degree drops are skipped.
+    remaining = 0;
+    for (v = 0; v < n; v++) {
+        degree.push_back(adj[v].size());
+        removed.push_back(alias[v] != v);
+        if (alias[v] != v) continue;
+
+        remaining++;
+        if (degree[v] < get_num_colors(eax_ok, v)) low.push_back(v);
+        else spill_queue.push(std::make_pair(cost[v] / degree[v], v));
     }
 
-    // There will only be one function.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Map instructions to number.
-        inst_index_opt = get_inst_index(bb);
+    while (remaining > 0) {
+        if (!low.empty()) {
+            best = low.back();
+            low.pop_back();
+        } else {
+            do {
+                best = spill_queue.top().second;
+                stale = removed[best] || spill_queue.top().first != cost[best] / degree[best];
+                spill_queue.pop();
+            } while (stale);
+        }
 
+        stack.push_back(best);
+        removed[best] = true;
+        remaining--;
+        for (adj_it = adj[best].begin(); adj_it != adj[best].end(); ++adj_it) {
+            if (removed[*adj_it]) continue;
 
-        if (!inst_index_opt.has_value()) {
-            std::cerr << "Failed to map instructions to indices.\n";
-            return std::nullopt;
-        } else
-            inst_index = inst_index_opt.value();
+            degree[*adj_it]--;
+            if (degree[*adj_it] == get_num_colors(eax_ok, *adj_it) - 1) low.push_back(*adj_it);
+            else if (degree[*adj_it] >= get_num_colors(eax_ok, *adj_it)) spill_queue.push(std::make_pair(cost[*adj_it] / degree[*adj_it], *adj_it));
+        }
+    }
 
-        // Get live range for each instruction.
-        live_range_opt = get_live_range(bb, inst_index);
+    // Select: color nodes in reverse order of removal.
+    color.assign(n, -1);
+    while (!stack.empty()) {
+        v = stack.back();
+        stack.pop_back();
+
+        for (r = 0; r < NUM_REGS; r++)
+            avail[r] = true;
+        for (adj_it = adj[v].begin(); adj_it != adj[v].end(); ++adj_it)
+            if (color[*adj_it] != -1) avail[color[*adj_it]] = false;
+
+        // %eax is the first choice of nodes that may use it and is never given to the others.
+        if (eax_ok[v] && avail[EAX_REG]) r = EAX_REG;
+        else r = pick_register(avail, crossing[v]);
+        if (r < NUM_REGS) color[v] = r;
+    }
 
-        if (!live_range_opt.has_value()) {
-            std::cerr << "Failed to obtain live ranges.\n";
-            return std::nullopt;
-        } else
-            live_range = live_range_opt.value();
+    for (v = 0; v < n; v++) {
+        if ((r = color[find_alias(alias, v)]) != -1)
+            ra.ranges[lv_opt.value().values[v]].push_back(LiveRange{0, INT_MAX, r});
+        else
+            ra.spilled.insert(lv_opt.value().values[v]);
+    }
 
-        // Get the number of uses of each instruction.
-        num_uses_map_opt = get_num_uses_map(bb);
+    return ra;
+}
 
-        if (!num_uses_map_opt.has_value()) {
-            std::cerr << "Failed to get num uses map.\n";
-            return std::nullopt;
-        } else
-            num_uses_map = num_uses_map_opt.value();
-
-        // Get sorted list of instructions (sorted by number of uses in ascending order).
-        sorted_list = get_sorted_list(num_uses_map);
-
-        // Initialize set of available registers.
-        for (i = 0; i < NUM_REGS; i++)
-            avail_regs.insert(i);
-
-        // Loop through all instructions in basic block.
-        for (inst = LLVMGetFirstInstruction(bb); inst != NULL; inst = LLVMGetNextInstruction(inst)) {
-            // Instructions that do not have a result.
-            if (LLVMGetTypeKind(LLVMTypeOf(inst)) == LLVMVoidTypeKind) {
-                // Check all operands and see if live range ends.
-                for (i = 0; i < LLVMGetNumOperands(inst); i++) {
-                    operand = LLVMGetOperand(inst, i);
-
-                    // Ignore alloca instructions.
-                    if (LLVMGetInstructionOpcode(operand) != LLVMAlloca && !LLVMIsAArgument(operand)) {
-                        // Check if live range ends.
-                        if (live_range[operand].second == inst_index[inst]) {
-                            // If operand is currently assigned a register, add the register to the set of available registers.
-                            if (reg_map.contains(operand) && reg_map[operand] != -1)
-                                avail_regs.insert(reg_map[operand]);
-                        }
-                    }
-                }
-            }
-            // Instructions that do have a result (ignoring alloca instructions).
-            else if (LLVMGetInstructionOpcode(inst) != LLVMAlloca && LLVMGetTypeKind(LLVMTypeOf(inst)) != LLVMVoidTypeKind) {
-                opcode = LLVMGetInstructionOpcode(inst);
-                // This is a special case in which a physical register can be saved if first operand has a register.
-                // Question: In the algorithm it specifies onluym add, mul and sub but should we be considering lt, gt, etc too? Check assembly to make sense of this.
-                if ((opcode == LLVMAdd || opcode == LLVMSub || opcode == LLVMMul) && reg_map.contains(LLVMGetOperand(inst, 0)) && reg_map[LLVMGetOperand(inst, 0)] != -1 && live_range[LLVMGetOperand(inst, 0)].second == inst_index[inst]) {
-                    // Assign instruction register of first operand.
-                    reg_map[inst] = reg_map[LLVMGetOperand(inst, 0)];
-
-                    // If live range of second operand ends and it has a register assgined to it, make register available.
-                    if (live_range[LLVMGetOperand(inst, 1)].second == inst_index[inst] && reg_map.contains(LLVMGetOperand(inst, 1)) && reg_map[LLVMGetOperand(inst, 1)] != -1)
-                        avail_regs.insert(reg_map[LLVMGetOperand(inst, 1)]);
-                }
-                // If there is an available pyhsical register.
-                else if (!avail_regs.empty()) {
-                    // Get a register from set.
-                    i = 0;
-                    do {
-                        // See if register is in available reegisters map.
-                        set_it = avail_regs.find(i);
-                        i++;
-                    } while (i < NUM_REGS && set_it == avail_regs.end());
-
-                    // Mpa instruction to register.
-                    reg_map[inst] = *set_it;
-
-                    // Remove regster from set of available registers.
-                    avail_regs.erase(*set_it);
-
-                    // Check to see if live range of any operand ends, then add register to list of available registers.
-                    for (i = 0; i < LLVMGetNumOperands(inst); i++) {
-                        if (live_range[LLVMGetOperand(inst, i)].second == inst_index[inst] && reg_map.contains(LLVMGetOperand(inst, i)) && reg_map[LLVMGetOperand(inst, i)] != -1)
-                            avail_regs.insert(reg_map[LLVMGetOperand(inst, i)]);
-                    }
-                }
-                // If there are no registers available.
-                else if (avail_regs.empty()) {
-                    // Find instruction to spill.
-                    opt_v = find_spills(inst, reg_map, inst_index, sorted_list, live_range);
-
-                    if (!opt_v.has_value()) {
-                        std::cerr << "Failed to find spills.\n";
-                        return std::nullopt;
-                    } else
-                        v = opt_v.value();
-
-                    // If spill insturction has more uses than current instruction, do not assign current instruction a register.
-                    if (num_uses_map[v] > num_uses_map[inst])
-                        reg_map[inst] = -1;
-                    // Spill V oherwise.
-                    else {
-                        reg_map[inst] = reg_map[v];
-                        reg_map[v] = -1;
-                    }
+/*
+ * Gets the register holding a value at a position.
+ *
+ * Returns:
+ * - Register number, -1 if the value is in memory there.
+ */
+static int get_location(const RegAllocation& ra, LLVMValueRef v, int pos) {
+    std::unordered_map<LLVMValueRef, std::vector<LiveRange>>::const_iterator range_it;
+    std::vector<LiveRange>::const_iterator piece_it;
+
+    if ((range_it = ra.ranges.find(v)) == ra.ranges.end()) return -1;
 
-                    // Check to see if live range of any operand ends to add its register back to list of available registers.
-                    for (i = 0; i < LLVMGetNumOperands(inst); i++) {
-                        if (live_range[LLVMGetOperand(inst, i)].second == inst_index[inst] && reg_map.contains(LLVMGetOperand(inst, i)) && reg_map[LLVMGetOperand(inst, i)] != -1)
-                            avail_regs.insert(reg_map[LLVMGetOperand(inst, i)]);
+    for (piece_it = range_it->second.begin(); piece_it != range_it->second.end(); ++piece_it)
+        if (piece_it->start <= pos && pos <= piece_it->end) return piece_it->reg;
+
+    return -1;
+}
+
+/*
+ * Summarizes an allocation: how many values were spilled, and how many copies were made redundant by sharing a register.
+ */
+static RegAllocStats get_alloc_stats(LLVMValueRef f, const RegAllocation& ra) {
+    RegAllocStats stats;
+    LLVMBasicBlockRef bb;
+    LLVMValueRef i, val;
+    unsigned int k;
+    int r;
+
+    stats = RegAllocStats{0, ra.spilled.size(), 0, 0};
+
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (!is_allocatable(i)) continue;
+
+            stats.values++;
+
+            if (LLVMGetInstructionOpcode(i) == LLVMPHI) {
+                r = get_location(ra, i, ra.block_range.at(bb).first);
+                for (k = 0; k < LLVMCountIncoming(i); k++) {
+                    if (is_allocatable(val = LLVMGetIncomingValue(i, k))) {
+                        stats.copies++;
+                        if (r != -1 && r == get_location(ra, val, ra.block_range.at(LLVMGetIncomingBlock(i, k)).second)) stats.copies_eliminated++;
                     }
                 }
+            } else if (is_two_address_operand(i, LLVMGetOperand(i, 0)) && is_allocatable(LLVMGetOperand(i, 0))) {
+                stats.copies++;
+                r = get_location(ra, i, get_def_position(ra, i));
+                if (r != -1 && r == get_location(ra, LLVMGetOperand(i, 0), ra.position.at(i))) stats.copies_eliminated++;
             }
         }
     }
 
-    return reg_map;
+    return stats;
+}
+
+/*
+ * Finds the callee-saved registers (%ebx, %esi, %edi) an allocation uses; the function must save and restore them.
+ *
+ * Returns:
+ * - Used callee-saved registers, in the order they are pushed.
+ */
+static std::vector<int> get_saved_registers(const RegAllocation& ra) {
+    std::unordered_map<LLVMValueRef, std::vector<LiveRange>>::const_iterator range_it;
+    std::vector<LiveRange>::const_iterator piece_it;
+    std::vector<int> saved;
+    bool used[NUM_REGS];
+    int r;
+
+    for (r = 0; r < NUM_REGS; r++)
+        used[r] = false;
+
+    for (range_it = ra.ranges.begin(); range_it != ra.ranges.end(); ++range_it)
+        for (piece_it = range_it->second.begin(); piece_it != range_it->second.end(); ++piece_it)
+            used[piece_it->reg] = true;
+
+    for (r = 0; r < NUM_REGS; r++)
+        if (used[r] && (r == 0 || r == 3 || r == 4)) saved.push_back(r);
+
+    return saved;
+}
+
+/*
+ * Finds the caller-saved registers that must be saved around a call: those holding values still needed after it.
+ * %eax never holds such a value.
+ *
+ * Args:
+ * - call: call instruction.
+ * - pos: position of the call.
+ * - ra: register allocation.
+ *
+ * Returns:
+ * - Registers to save, in the order they are pushed.
+ */
+static std::vector<int> get_call_saved_registers(LLVMValueRef call, int pos, const RegAllocation& ra) {
+    std::unordered_map<LLVMValueRef, std::vector<LLVMValueRef>>::const_iterator live_it;
+    std::vector<LLVMValueRef>::const_iterator v_it;
+    std::vector<int> saved;
+    bool live[NUM_REGS];
+    int r;
+
+    for (r = 0; r < NUM_REGS; r++)
+        live[r] = false;
+
+    if ((live_it = ra.live_across_calls.find(call)) != ra.live_across_calls.end())
+        for (v_it = live_it->second.begin(); v_it != live_it->second.end(); ++v_it)
+            if ((r = get_location(ra, *v_it, pos)) != -1) live[r] = true;
+
+    for (r = 0; r < NUM_REGS; r++)
+        if (live[r] && (r == 1 || r == 2)) saved.push_back(r);
+
+    return saved;
+}
+
+/*
+ * Formats an operand read at a position: an immediate, the register holding the value, or its stack slot.
+ */
+static std::string get_operand(LLVMValueRef v, int pos, const RegAllocation& ra, std::unordered_map<LLVMValueRef, int>& offset_map, std::unordered_map<int, std::string>& reg) {
+    int r;
+
+    if (LLVMIsConstant(v)) return std::format("${}", LLVMConstIntGetSExtValue(v));
+    if ((r = get_location(ra, v, pos)) != -1) return reg[r];
+    return std::format("{}(%ebp)", offset_map[v]);
+}
+
+/*
+ * Gets the register an instruction's result is computed in: its own register, or %eax if it is written straight to memory.
+ */
+static std::string get_result_reg(LLVMValueRef i, const RegAllocation& ra, std::unordered_map<int, std::string>& reg) {
+    int r;
+
+    if ((r = get_location(ra, i, get_def_position(ra, i))) == -1) return std::string("%eax");
+    return reg[r];
+}
+
+/*
+ * Stores a result to its stack slot if the value is in memory at its definition or at some later point.
+ */
+static void print_result_store(std::ofstream& ofile, LLVMValueRef i, const std::string& r, const RegAllocation& ra, std::unordered_map<LLVMValueRef, int>& offset_map) {
+    if (get_location(ra, i, get_def_position(ra, i)) == -1 || ra.spilled.contains(i))
+        ofile << std::format("\tmovl {}, {}(%ebp)\n", r, offset_map[i]);
+}
+
+/*
+ * Emits a move between two operand locations, going through %eax if both are in memory.
+ */
+static void print_move(std::ofstream& ofile, const std::string& src, const std::string& dst) {
+    if (src.find('(') != std::string::npos && dst.find('(') != std::string::npos) {
+        ofile << std::format("\tmovl {}, %eax\n", src);
+        ofile << std::format("\tmovl %eax, {}\n", dst);
+    } else
+        ofile << std::format("\tmovl {}, {}\n", src, dst);
+}
+
+/*
+ * Checks whether an edge needs code: copies into the successor's phis, or values the successor expects in a different register.
+ */
+static bool has_edge_moves(LLVMBasicBlockRef pred, LLVMBasicBlockRef succ, const RegAllocation& ra) {
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMValueRef>>::const_iterator live_it;
+    std::vector<LLVMValueRef>::const_iterator v_it;
+    int r;
+
+    if (has_phis(succ)) return true;
+    if ((live_it = ra.live_in.find(succ)) == ra.live_in.end()) return false;
+
+    for (v_it = live_it->second.begin(); v_it != live_it->second.end(); ++v_it) {
+        r = get_location(ra, *v_it, ra.block_range.at(succ).first);
+        if (r != -1 && r != get_location(ra, *v_it, ra.block_range.at(pred).second)) return true;
+    }
+
+    return false;
+}
+
+/*
+ * Emits the code for an edge.
+ * The successor's phis are assigned as one parallel copy from the locations of their incoming values at the end of the predecessor;
+ * copies are ordered so none overwrites a location another still reads, and cycles are broken through the temporary slot.
+ * Values live into the successor that it expects in a different register are then reloaded from their slots.
+ *
+ * Args:
+ * - ofile: output file.
+ * - pred: block the edge leaves.
+ * - succ: block the edge enters.
+ * - ra: register allocation.
+ * - offset_map: stack slot of each value.
+ * - reg: register names.
+ * - tmp_offset: slot for breaking copy cycles.
+ *
+ * Returns:
+ * - 0 on success, -1 on failure.
+ */
+static int print_edge_moves(std::ofstream& ofile, LLVMBasicBlockRef pred, LLVMBasicBlockRef succ, const RegAllocation& ra, std::unordered_map<LLVMValueRef, int>& offset_map, std::unordered_map<int, std::string>& reg, int tmp_offset) {
+    std::vector<std::pair<std::string, std::string>> copies;
+    std::vector<std::pair<std::string, std::string>>::iterator it, jt;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMValueRef>>::const_iterator live_it;
+    std::vector<LLVMValueRef>::const_iterator v_it;
+    std::string dst, src, tmp;
+    LLVMValueRef phi, val;
+    int start, end, r;
+    bool blocked;
+
+    if (pred == NULL || succ == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return -1;
+    }
+
+    start = ra.block_range.at(succ).first;
+    end = ra.block_range.at(pred).second;
+    tmp = std::format("{}(%ebp)", tmp_offset);
+
+    // Collect the parallel copy from each phi's incoming value along this edge into the phi's location.
+    for (phi = LLVMGetFirstInstruction(succ); phi != NULL && LLVMGetInstructionOpcode(phi) == LLVMPHI; phi = LLVMGetNextInstruction(phi)) {
+        if ((val = get_incoming_value(phi, pred)) == NULL) {
+            std::cerr << "Phi has no value for predecessor.\n";
+            return -1;
+        }
+
+        dst = get_operand(phi, start, ra, offset_map, reg);
+        src = get_operand(val, end, ra, offset_map, reg);
+        if (dst != src)
+            copies.push_back(std::make_pair(dst, src));
+    }
+
+    // Sequentialize: emit a copy once no other pending copy still reads its destination.
+    // If only cycles remain, park one destination's old value in the temporary slot.
+    while (!copies.empty()) {
+        for (it = copies.begin(); it != copies.end(); ++it) {
+            blocked = false;
+            for (jt = copies.begin(); jt != copies.end() && !blocked; ++jt)
+                if (jt != it && jt->second == it->first)
+                    blocked = true;
+
+            if (!blocked)
+                break;
+        }
+
+        if (it != copies.end()) {
+            print_move(ofile, it->second, it->first);
+            copies.erase(it);
+        } else {
+            dst = copies.front().first;
+            print_move(ofile, dst, tmp);
+
+            // Readers of the parked value now read the temporary slot.
+            for (jt = copies.begin(); jt != copies.end(); ++jt)
+                if (jt->second == dst)
+                    jt->second = tmp;
+        }
+    }
+
+    // Phis assigned a register that are in memory later also need their slot written.
+    for (phi = LLVMGetFirstInstruction(succ); phi != NULL && LLVMGetInstructionOpcode(phi) == LLVMPHI; phi = LLVMGetNextInstruction(phi))
+        if ((r = get_location(ra, phi, start)) != -1 && ra.spilled.contains(phi))
+            ofile << std::format("\tmovl {}, {}(%ebp)\n", reg[r], offset_map[phi]);
+
+    if ((live_it = ra.live_in.find(succ)) == ra.live_in.end()) return 0;
+
+    for (v_it = live_it->second.begin(); v_it != live_it->second.end(); ++v_it) {
+        r = get_location(ra, *v_it, start);
+        if (r != -1 && r != get_location(ra, *v_it, end))
+            ofile << std::format("\tmovl {}(%ebp), {}\n", offset_map[*v_it], reg[r]);
+    }
+
+    return 0;
 }
 
-int code_gen(LLVMModuleRef m, std::string fname) {
+
+/*
+ * Generates 32-bit x86 assembly for the function with a body in a module.
+ *
+ * Args:
+ * - m: module to compile.
+ * - fname: assembly file to write.
+ * - allocator: register allocator to use.
+ * - stats: if not NULL, set to a summary of the register allocation.
+ *
+ * Returns:
+ * - 0 on success, -1 on failure.
+ */
+int code_gen(LLVMModuleRef m, std::string fname, RegAllocator allocator, RegAllocStats* stats) {
     std::ofstream ofile;
     std::unordered_map<LLVMBasicBlockRef, std::string> labels;
     std::optional<std::unordered_map<LLVMBasicBlockRef, std::string>> labels_opt;
     std::unordered_map<LLVMValueRef, int> offset_map;
     std::optional<std::unordered_map<LLVMValueRef, int>> offset_map_opt;
-    std::unordered_map<LLVMValueRef, int> reg_map;
-    std::optional<std::unordered_map<LLVMValueRef, int>> reg_map_opt;
+    RegAllocation ra;
+    std::optional<RegAllocation> ra_opt;
+    std::unordered_map<int, std::vector<std::pair<LLVMValueRef, int>>>::iterator reload_it;
+    std::vector<std::pair<LLVMValueRef, int>>::iterator v_it;
+    std::vector<int> saved, call_saved;
+    std::vector<int>::iterator saved_it;
+    std::vector<int>::reverse_iterator restore_it;
+    std::optional<LLVMValueRef> f_opt;
     LLVMValueRef f, i, op1, op2;
-    LLVMBasicBlockRef bb;
-    int local_mem;
+    LLVMBasicBlockRef bb, true_bb, false_bb;
+    int local_mem, tmp_offset, pos;
     LLVMOpcode op;
     std::unordered_map<int, std::string> reg;
-    std::string r, opr, funcname;
-    LLVMIntPredicate pred;
+    std::string r, src, opr, funcname;
+    std::optional<std::string> cc_opt;
+    LLVMValueRef cond;
 
     if (m == NULL) {
         std::cerr << "Invlaid argument to function.\n";
@@ -485,6 +1332,9 @@ int code_gen(LLVMModuleRef m, std::string fname) {
     reg[0] = std::string("%ebx");
     reg[1] = std::string("%ecx");
     reg[2] = std::string("%edx");
+    reg[3] = std::string("%esi");
+    reg[4] = std::string("%edi");
+    reg[EAX_REG] = std::string("%eax");
 
     ofile = std::ofstream(fname);
 
@@ -493,14 +1343,20 @@ int code_gen(LLVMModuleRef m, std::string fname) {
         return -1;
     }
 
+    // Find the function body once; all later steps work on it.
+    f_opt = find_function_body(m);
+
+    if (!f_opt.has_value()) return -1;
+    else f = f_opt.value();
+
     // Mpa basic blocks to label names.
-    labels_opt = create_bb_labels(m);
+    labels_opt = create_bb_labels(f);
 
     if (!labels_opt.has_value()) {
         std::cerr << "Failed to map basic blocks to labels.\n";
         return -1;
     } else
-        labels = labels_opt.value();
+        labels = std::move(labels_opt.value());
 
     if (print_directives(ofile) != 0) {
         std::cerr << "Failed to print directives.\n";
@@ -508,40 +1364,39 @@ int code_gen(LLVMModuleRef m, std::string fname) {
     }
 
     // Map instructions to offsets.
-    offset_map_opt = get_offset_map(m, local_mem);
+    offset_map_opt = get_offset_map(f, local_mem);
 
     if (!offset_map_opt.has_value()) {
         std::cerr << "Failed to get offset map.\n";
         return -1;
     } else
-        offset_map = offset_map_opt.value();
+        offset_map = std::move(offset_map_opt.value());
 
-    // Get register map.
-    reg_map_opt = allocate_registers(m);
+    // Reserve a temporary slot for breaking cycles between phi copies.
+    tmp_offset = -local_mem;
+    local_mem += 4;
 
-    if (!reg_map_opt.has_value()) {
+    // Allocate registers over the whole function.
+    if (allocator == REGALLOC_GRAPH_COLORING) ra_opt = color_registers(f);
+    else ra_opt = allocate_registers(f);
+
+    if (!ra_opt.has_value()) {
         std::cerr << "Failed to allocate registers.\n";
         return -1;
     } else
-        reg_map = reg_map_opt.value();
+        ra = std::move(ra_opt.value());
 
-    // There will only be one function with a body.
-    if ((f = LLVMGetFirstFunction(m)) == NULL) {
-        std::cerr << "Could not find function ref.\n";
-        return -1;
-    }
-
-    while (LLVMGetFirstBasicBlock(f) == NULL) {
-        if ((f = LLVMGetNextFunction(f)) == NULL) {
-            std::cerr << "Could not find function ref.\n";
-            return -1;
-        }
-    }
+    if (stats != NULL)
+        *stats = get_alloc_stats(f, ra);
 
     ofile << "\tpushl %ebp\n";
     ofile << "\tmovl %esp, %ebp\n";
     ofile << std::format("\tsubl ${}, %esp\n", local_mem);
-    ofile << "\tpushl %ebx\n";
+
+    // Save only the callee-saved registers the allocation uses.
+    saved = get_saved_registers(ra);
+    for (saved_it = saved.begin(); saved_it != saved.end(); ++saved_it)
+        ofile << std::format("\tpushl {}\n", reg[*saved_it]);
 
     for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
         // Emit basic block label.
@@ -550,52 +1405,49 @@ int code_gen(LLVMModuleRef m, std::string fname) {
         for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
             op = LLVMGetInstructionOpcode(i);
 
+            if (op == LLVMAlloca)
+                continue;
+
+            pos = ra.position[i];
+
+            // Split values that get their register back here are reloaded before being read.
+            if ((reload_it = ra.reloads.find(pos)) != ra.reloads.end()) {
+                for (v_it = reload_it->second.begin(); v_it != reload_it->second.end(); ++v_it)
+                    ofile << std::format("\tmovl {}(%ebp), {}\n", offset_map[v_it->first], reg[v_it->second]);
+            }
+
             if (op == LLVMRet) {
-                op1 = LLVMGetOperand(i, 0);
-                if (LLVMIsConstant(op1))
-                    ofile << std::format("\tmovl ${}, %eax\n", LLVMConstIntGetSExtValue(op1));
-                else if (reg_map[op1] == -1)
-                    ofile << std::format("\tmovl {}(%ebp), %eax\n", offset_map[op1]);
-                else if (reg_map[op1] != -1)
-                    ofile << std::format("\tmovl {}, %eax\n", reg[reg_map[op1]]);
+                if ((src = get_operand(LLVMGetOperand(i, 0), pos, ra, offset_map, reg)) != "%eax")
+                    ofile << std::format("\tmovl {}, %eax\n", src);
 
-                ofile << "\tpopl %ebx\n";
+                for (restore_it = saved.rbegin(); restore_it != saved.rend(); ++restore_it)
+                    ofile << std::format("\tpopl {}\n", reg[*restore_it]);
 
                 if (print_function_end(ofile) != 0) {
                     std::cerr << "Failed to print function postlude.\n";
                     return -1;
                 }
             } else if (op == LLVMLoad) {
-                if (reg_map[i] != -1)
-                    ofile << std::format("\tmovl {}(%ebp), {}\n", offset_map[LLVMGetOperand(i, 0)], reg[reg_map[i]]);
+                r = get_result_reg(i, ra, reg);
+                ofile << std::format("\tmovl {}(%ebp), {}\n", offset_map[LLVMGetOperand(i, 0)], r);
+                print_result_store(ofile, i, r, ra, offset_map);
             } else if (op == LLVMStore) {
                 op1 = LLVMGetOperand(i, 0);
                 op2 = LLVMGetOperand(i, 1);
 
                 // Ignore stores of parameters.
-                if (!LLVMIsAArgument(op1) && LLVMIsConstant(op1))
-                    ofile << std::format("\tmovl ${}, {}(%ebp)\n", LLVMConstIntGetSExtValue(op1), offset_map[op2]);
-                else if (!LLVMIsAArgument(op1) && reg_map[op1] != -1)
-                    ofile << std::format("\tmovl {}, {}(%ebp)\n", reg[reg_map[op1]], offset_map[op1]);
-                else if (!LLVMIsAArgument(op1) && reg_map[op1] == -1) {
-                    ofile << std::format("\tmovl {}(%ebp), %eax\n", offset_map[op1]);
-                    ofile << std::format("\tmovl %eax, {}(%ebp)\n", offset_map[op2]);
-                }
+                if (!LLVMIsAArgument(op1))
+                    print_move(ofile, get_operand(op1, pos, ra, offset_map, reg), std::format("{}(%ebp)", offset_map[op2]));
             } else if (op == LLVMCall) {
-                ofile << "\tpushl %ecx\n";
-                ofile << "\tpushl %edx\n";
+                // Save the caller-saved registers holding values still needed after the call.
+                call_saved = get_call_saved_registers(i, pos, ra);
+                for (saved_it = call_saved.begin(); saved_it != call_saved.end(); ++saved_it)
+                    ofile << std::format("\tpushl {}\n", reg[*saved_it]);
 
                 // Check if function has a parameter.
                 if (LLVMGetNumArgOperands(i) != 0) {
                     op1 = LLVMGetArgOperand(i, 0);
-                    LLVMDumpValue(op1);
-                    std::cout << std::endl;
-                    if (LLVMIsConstant(op1))
-                        ofile << std::format("\tpushl ${}\n", LLVMConstIntGetSExtValue(op1));
-                    else if (reg_map[op1] != -1)
-                        ofile << std::format("\tpushl {}\n", reg[reg_map[op1]]);
-                    else if (reg_map[op1] == -1)
-                        ofile << std::format("\tpushl {}(%ebp)\n", offset_map[op1]);
+                    ofile << std::format("\tpushl {}\n", get_operand(op1, pos, ra, offset_map, reg));
                     funcname = std::string("print");
                 } else
                 funcname = std::string("read");
@@ -606,57 +1458,73 @@ int code_gen(LLVMModuleRef m, std::string fname) {
                 if (LLVMGetNumArgOperands(i) != 0)
                     ofile << "\taddl $4, %esp\n";
 
-                ofile << "\tpopl %edx\n";
-                ofile << "\tpopl %ecx\n";
+                for (restore_it = call_saved.rbegin(); restore_it != call_saved.rend(); ++restore_it)
+                    ofile << std::format("\tpopl {}\n", reg[*restore_it]);
 
                 // See if called function returns a value.
                 if (LLVMGetTypeKind(LLVMTypeOf(i)) != LLVMVoidTypeKind) {
-                    if (reg_map[i] != -1)
-                        ofile << std::format("\tmovl %eax, {}\n", reg[reg_map[i]]);
-                    else
-                        ofile << std::format("\tmovl %eax, {}(%ebp)\n", offset_map[i]);
+                    r = get_result_reg(i, ra, reg);
+                    if (r != "%eax")
+                        ofile << std::format("\tmovl %eax, {}\n", r);
+                    print_result_store(ofile, i, r, ra, offset_map);
                 }
             } else if (op == LLVMBr) {
                 if (LLVMIsConditional(i)) {
-                    pred = LLVMGetICmpPredicate(LLVMGetOperand(i, 0));
+                    cond = LLVMGetOperand(i, 0);
                     op1 = LLVMGetOperand(i, 2);
                     op2 = LLVMGetOperand(i, 1);
 
                     // Set jump type.
-                    switch (pred) {
-                        case LLVMIntEQ:
-                            opr = std::string("je");
-                            break;
-                        case LLVMIntNE:
-                            opr = std::string("jne");
-                            break;
-                        case LLVMIntSGT:
-                            opr = std::string("jg");
-                            break;
-                        case LLVMIntSGE:
-                            opr = std::string("jge");
-                            break;
-                        case LLVMIntSLT:
-                            opr = std::string("jl");
-                            break;
-                        case LLVMIntSLE:
-                            opr = std::string("jle");
-                            break;
-                        default:
-                            std::cerr << "Unknown predicate.\n";
+                    if (LLVMIsConstant(cond))
+                        // Constant condition: jump straight to the taken successor.
+                        opr = std::string("jmp");
+                    else if (is_fused_compare(cond)) {
+                        // Flags are still set by the comparison.
+                        if (!(cc_opt = get_condition_code(LLVMGetICmpPredicate(cond))).has_value()) return -1;
+                        opr = std::string("j") + cc_opt.value();
+                    } else {
+                        // Test the materialized comparison result.
+                        ofile << std::format("\tcmpl $0, {}\n", get_operand(cond, pos, ra, offset_map, reg));
+                        opr = std::string("jne");
+                    }
+
+                    // A false constant condition always takes the false edge.
+                    if (LLVMIsConstant(cond) && LLVMConstIntGetZExtValue(cond) == 0) op1 = op2;
+
+                    true_bb = LLVMValueAsBasicBlock(op1);
+                    false_bb = LLVMValueAsBasicBlock(op2);
+
+                    // Edges that need code go through an edge block.
+                    if (has_edge_moves(bb, true_bb, ra))
+                        ofile << std::format("\t{} {}_{}\n", opr, labels[bb], labels[true_bb]);
+                    else
+                        ofile << std::format("\t{} {}\n", opr, labels[true_bb]);
+
+                    if (print_edge_moves(ofile, bb, false_bb, ra, offset_map, reg, tmp_offset) != 0) {
+                        std::cerr << "Failed to print edge moves.\n";
+                        return -1;
+                    }
+                    ofile << std::format("\tjmp {}\n", labels[false_bb]);
+
+                    if (has_edge_moves(bb, true_bb, ra)) {
+                        ofile << std::format("{}_{}:\n", labels[bb], labels[true_bb]);
+                        if (print_edge_moves(ofile, bb, true_bb, ra, offset_map, reg, tmp_offset) != 0) {
+                            std::cerr << "Failed to print edge moves.\n";
                             return -1;
+                        }
+                        ofile << std::format("\tjmp {}\n", labels[true_bb]);
                     }
+                } else {
+                    true_bb = LLVMValueAsBasicBlock(LLVMGetOperand(i, 0));
 
-                    ofile << std::format("\t{} {}\n", opr, labels[LLVMValueAsBasicBlock(op1)]);
-                    ofile << std::format("\tjmp {}\n", labels[LLVMValueAsBasicBlock(op2)]);
-                } else
-                ofile << std::format("\tjmp {}\n", labels[LLVMValueAsBasicBlock(LLVMGetOperand(i, 0))]);
-            } else if (op == LLVMAdd || op == LLVMSub || op == LLVMMul) {
-                // Check whetehr instruction has a physical register assigned to it.
-                if (reg_map[i] == -1)
-                    r = std::string("%eax");
-                else
-                    r = reg[reg_map[i]];
+                    if (print_edge_moves(ofile, bb, true_bb, ra, offset_map, reg, tmp_offset) != 0) {
+                        std::cerr << "Failed to print edge moves.\n";
+                        return -1;
+                    }
+                    ofile << std::format("\tjmp {}\n", labels[true_bb]);
+                }
+            } else if (op == LLVMAdd || op == LLVMSub || op == LLVMMul || op == LLVMAnd || ((op == LLVMShl || op == LLVMLShr) && LLVMIsConstant(LLVMGetOperand(i, 1)))) {
+                r = get_result_reg(i, ra, reg);
 
                 op1 = LLVMGetOperand(i, 0);
                 op2 = LLVMGetOperand(i, 1);
@@ -667,48 +1535,48 @@ int code_gen(LLVMModuleRef m, std::string fname) {
                     opr = std::string("subl");
                 else if (op == LLVMMul)
                     opr = std::string("imul");
-
-                if (LLVMIsConstant(op1))
-                    ofile << std::format("\tmovl ${}, {}\n", LLVMConstIntGetSExtValue(op1), r);
-                else if (reg_map[op1] != -1)
-                    ofile << std::format("\tmovl {}, {}\n", reg[reg_map[op1]], r);
-                else if (reg_map[op1] == -1)
-                    ofile << std::format("\tmovl {}(%ebp), {}\n", offset_map[op1], r);
-
-                if (LLVMIsConstant(op2))
-                    ofile << std::format("\t{} ${}, {}\n", opr, LLVMConstIntGetSExtValue(op2), r);
-                else if (reg_map[op2] != -1)
-                    ofile << std::format("\t{} {}, {}\n", opr, reg[reg_map[op2]], r);
-                else if (reg_map[op2] == -1)
-                    ofile << std::format("\t{} {}(%ebp), {}\n", opr, offset_map[op2], r);
-
-                // If instruction is in memory, move from register to memory.
-                if (reg_map[i] == -1)
-                    ofile << std::format("\tmovl %eax, {}(%ebp)\n", offset_map[i]);
+                else if (op == LLVMAnd)
+                    opr = std::string("andl");
+                else if (op == LLVMShl)
+                    opr = std::string("shll");
+                else if (op == LLVMLShr)
+                    opr = std::string("shrl");
+
+                // The result may reuse the first operand's register.
+                if ((src = get_operand(op1, pos, ra, offset_map, reg)) != r)
+                    ofile << std::format("\tmovl {}, {}\n", src, r);
+                ofile << std::format("\t{} {}, {}\n", opr, get_operand(op2, pos, ra, offset_map, reg), r);
+
+                print_result_store(ofile, i, r, ra, offset_map);
             } else if (op == LLVMICmp) {
-                // Check whetehr instruction has a physical register assigned to it.
-                if (reg_map[i] == -1)
-                    r = std::string("%eax");
-                else
-                    r = reg[reg_map[i]];
+                r = get_result_reg(i, ra, reg);
 
                 op1 = LLVMGetOperand(i, 0);
                 op2 = LLVMGetOperand(i, 1);
 
+                if ((src = get_operand(op1, pos, ra, offset_map, reg)) != r)
+                    ofile << std::format("\tmovl {}, {}\n", src, r);
+                ofile << std::format("\tcmpl {}, {}\n", get_operand(op2, pos, ra, offset_map, reg), r);
+
+                // Result is needed somewhere other than the next branch: store it as 0 or 1.
+                if (!is_fused_compare(i)) {
+                    if (!(cc_opt = get_condition_code(LLVMGetICmpPredicate(i))).has_value()) return -1;
+                    ofile << std::format("\tset{} %al\n", cc_opt.value());
+                    ofile << std::format("\tmovzbl %al, {}\n", r);
+                    print_result_store(ofile, i, r, ra, offset_map);
+                }
+            } else if (op == LLVMZExt) {
+                // Compare results are already materialized as 0 or 1; only a folded constant needs its unsigned value.
+                r = get_result_reg(i, ra, reg);
+
+                op1 = LLVMGetOperand(i, 0);
                 if (LLVMIsConstant(op1))
-                    ofile << std::format("\tmovl ${}, {}\n", LLVMConstIntGetSExtValue(op1), r);
-                else if (reg_map[op1] != -1)
-                    ofile << std::format("\tmovl {}, {}\n", reg[reg_map[op1]], r);
-                else if (reg_map[op1] == -1)
-                    ofile << std::format("\tmovl {}(%ebp), {}\n", offset_map[op1], r);
-
-                if (LLVMIsConstant(op2))
-                    ofile << std::format("\tcmpl ${}, {}\n", LLVMConstIntGetSExtValue(op2), r);
-                else if (reg_map[op2] != -1)
-                    ofile << std::format("\tcmpl {}, {}\n", reg[reg_map[op2]], r);
-                else if (reg_map[op2] == -1)
-                    ofile << std::format("\tcmpl {}(%ebp), {}\n", offset_map[op2], r);
-            } else if (op != LLVMAlloca) {
+                    ofile << std::format("\tmovl ${}, {}\n", LLVMConstIntGetZExtValue(op1), r);
+                else if ((src = get_operand(op1, pos, ra, offset_map, reg)) != r)
+                    ofile << std::format("\tmovl {}, {}\n", src, r);
+
+                print_result_store(ofile, i, r, ra, offset_map);
+            } else if (op != LLVMPHI) {
                 std::cerr << "Invalid instruction type.\n";
                 return -1;
             }
@@ -13,4 +13,26 @@
 #include <optional>
 #include <fstream>
 
-int code_gen(LLVMModuleRef m, std::string fname);
+/*
+ * Register allocators code_gen can use.
+ * - REGALLOC_LINEAR_SCAN: linear scan over live intervals, splitting intervals under pressure; fast.
+ * - REGALLOC_GRAPH_COLORING: Chaitin-Briggs coloring of the interference graph with conservative coalescing; slower, fewer copies.
+ */
+enum RegAllocator {
+    REGALLOC_LINEAR_SCAN,
+    REGALLOC_GRAPH_COLORING
+};
+
+/*
+ * Summary of a register allocation.
+ * Copies are the moves into phis along each edge and the moves of the first operand into the result of two-address instructions;
+ * a copy is eliminated when its source and destination got the same register.
+ */
+struct RegAllocStats {
+    size_t values;
+    size_t spilled;
+    size_t copies;
+    size_t copies_eliminated;
+};
+
+int code_gen(LLVMModuleRef m, std::string fname, RegAllocator allocator = REGALLOC_LINEAR_SCAN, RegAllocStats* stats = NULL);
@@ -0,0 +1,221 @@
+/*
+ * bitvector.cpp - dense bit sets for dataflow analysis
+ *
+ * Josh Meise
+ * 10-18-2026
+ * Description:
+ * - Fixed-size set of small integers stored as 64-bit words.
+ * - Set operations work a word at a time in simple loops that the compiler can vectorize.
+ *
+ */
+
+#include "bitvector.h"
+
+/*
+ * Default constructor for BitVector object.
+ *
+ * Returns:
+ * - BitVector: empty set over an empty universe.
+ */
+BitVector::BitVector(void) {
+    num_bits = 0;
+}
+
+/*
+ * Constructs an empty BitVector over a universe of the given size.
+ *
+ * Args:
+ * - num_bits (size_t): number of elements in the universe
+ *
+ * Returns:
+ * - BitVector: empty set
+ */
+BitVector::BitVector(size_t num_bits) {
+    this->num_bits = num_bits;
+    words.assign((num_bits + 63) / 64, 0);
+}
+
+/*
+ * Getter method for size of universe.
+ */
+size_t BitVector::size(void) const { return num_bits; }
+
+/*
+ * Counts the number of elements in the set.
+ */
+size_t BitVector::count(void) const {
+    size_t k, num;
+
+    num = 0;
+    for (k = 0; k < words.size(); k++) num += __builtin_popcountll(words[k]);
+
+    return num;
+}
+
+/*
+ * Adds an element to the set.
+ */
+void BitVector::set(size_t bit) { words[bit / 64] |= (uint64_t)1 << (bit % 64); }
+
+/*
+ * Removes an element from the set.
+ */
+void BitVector::reset(size_t bit) { words[bit / 64] &= ~((uint64_t)1 << (bit % 64)); }
+
+/*
+ * Checks whether an element is in the set.
+ */
+bool BitVector::test(size_t bit) const { return (words[bit / 64] >> (bit % 64)) & 1; }
+
+/*
+ * Removes all elements from the set.
+ */
+void BitVector::clear(void) {
+    size_t k;
+
+    for (k = 0; k < words.size(); k++) words[k] = 0;
+}
+
+/*
+ * Adds every element of the universe to the set.
+ */
+void BitVector::set_all(void) {
+    size_t k;
+
+    for (k = 0; k < words.size(); k++) words[k] = ~(uint64_t)0;
+
+    // Keep bits past the end of the universe clear so count and comparison stay exact.
+    if (num_bits % 64 != 0) words.back() &= ((uint64_t)1 << (num_bits % 64)) - 1;
+}
+
+/*
+ * Finds the smallest element in the set.
+ *
+ * Returns:
+ * - Smallest element, size() if the set is empty
+ */
+size_t BitVector::find_first(void) const { return find_next(0); }
+
+/*
+ * Finds the smallest element in the set that is not less than bit.
+ *
+ * Args:
+ * - bit (size_t): element at which to start searching
+ *
+ * Returns:
+ * - Next element, size() if there is none
+ */
+size_t BitVector::find_next(size_t bit) const {
+    size_t k;
+    uint64_t w;
+
+    if (bit >= num_bits) return num_bits;
+
+    // Mask off bits below the starting bit in the first word.
+    k = bit / 64;
+    w = words[k] & (~(uint64_t)0 << (bit % 64));
+    while (w == 0) {
+        if (++k == words.size()) return num_bits;
+        w = words[k];
+    }
+
+    return k * 64 + __builtin_ctzll(w);
+}
+
+/*
+ * Adds all elements of another set to this set.
+ *
+ * Args:
+ * - other (const BitVector&): set over the same universe
+ *
+ * Returns:
+ * - True if this set changed, false otherwise
+ */
+bool BitVector::union_with(const BitVector& other) {
+    size_t k;
+    uint64_t diff, w;
+
+    diff = 0;
+    for (k = 0; k < words.size(); k++) {
+        w = words[k] | other.words[k];
+        diff |= w ^ words[k];
+        words[k] = w;
+    }
+
+    return diff != 0;
+}
+
+/*
+ * Intersects this set with another set.
+ *
+ * Args:
+ * - other (const BitVector&): set over the same universe
+ *
+ * Returns:
+ * - True if this set changed, false otherwise
+ */
+bool BitVector::intersect_with(const BitVector& other) {
+    size_t k;
+    uint64_t diff, w;
+
+    diff = 0;
+    for (k = 0; k < words.size(); k++) {
+        w = words[k] & other.words[k];
+        diff |= w ^ words[k];
+        words[k] = w;
+    }
+
+    return diff != 0;
+}
+
+/*
+ * Removes all elements of another set from this set.
+ *
+ * Args:
+ * - other (const BitVector&): set over the same universe
+ */
+void BitVector::subtract(const BitVector& other) {
+    size_t k;
+
+    for (k = 0; k < words.size(); k++) words[k] &= ~other.words[k];
+}
+
+/*
+ * Sets this set to GEN union (IN minus KILL), the transfer function of gen/kill dataflow problems.
+ *
+ * Args:
+ * - gen (const BitVector&): GEN set
+ * - in (const BitVector&): input set
+ * - kill (const BitVector&): KILL set
+ *
+ * Returns:
+ * - True if this set changed, false otherwise
+ */
+bool BitVector::transfer(const BitVector& gen, const BitVector& in, const BitVector& kill) {
+    size_t k;
+    uint64_t diff, w;
+
+    diff = 0;
+    for (k = 0; k < words.size(); k++) {
+        w = gen.words[k] | (in.words[k] & ~kill.words[k]);
+        diff |= w ^ words[k];
+        words[k] = w;
+    }
+
+    return diff != 0;
+}
+
+/*
+ * Checks whether two sets over the same universe are equal.
+ */
+bool BitVector::operator==(const BitVector& other) const {
+    size_t k;
+    uint64_t diff;
+
+    if (num_bits != other.num_bits) return false;
+
+    diff = 0;
+    for (k = 0; k < words.size(); k++) diff |= words[k] ^ other.words[k];
+
+    return diff == 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * bitvector.h - dense bit sets for dataflow analysis
+ *
+ * Josh Meise
+ * 10-18-2026
+ * Description:
+ * - Fixed-size set of small integers stored as 64-bit words.
+ * - Set operations work a word at a time in simple loops that the compiler can vectorize.
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class BitVector {
+public:
+    BitVector(void);
+    BitVector(size_t num_bits);
+
+    size_t size(void) const;
+    size_t count(void) const;
+
+    void set(size_t bit);
+    void reset(size_t bit);
+    bool test(size_t bit) const;
+    void clear(void);
+    void set_all(void);
+
+    size_t find_first(void) const;
+    size_t find_next(size_t bit) const;
+
+    bool union_with(const BitVector& other);
+    bool intersect_with(const BitVector& other);
+    void subtract(const BitVector& other);
+    bool transfer(const BitVector& gen, const BitVector& in, const BitVector& kill);
+
+    bool operator==(const BitVector& other) const;
+
+private:
+    std::vector<uint64_t> words;
+    size_t num_bits;
+};
@@ -0,0 +1,146 @@
+/*
+ * dataflow.h - generic iterative dataflow analysis
+ *
+ * Josh Meise
+ * 10-18-2026
+ * Description:
+ * - Worklist solver parameterized on direction, domain, transfer function and meet operator.
+ * - All parameters are template arguments, so each analysis is compiled into its own solver with no virtual calls.
+ * - Blocks are identified by number; the solver assumes ascending numbers are a reverse post-order of the CFG.
+ * - Common transfer functions and meet operators for bit vector problems.
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <set>
+#include <vector>
+#include "bitvector.h"
+
+enum class Direction { Forward, Backward };
+
+/*
+ * Transfer function of the form OUT = GEN | (IN & ~KILL) for bit vector problems.
+ */
+struct GenKillTransfer {
+    const std::vector<BitVector>& gen;
+    const std::vector<BitVector>& kill;
+
+    bool operator()(size_t b, const BitVector& input, BitVector& output) const { return output.transfer(gen[b], input, kill[b]); }
+};
+
+/*
+ * Meet operator for may problems: union of incoming sets.
+ */
+struct UnionMeet {
+    void operator()(BitVector& acc, const BitVector& other) const { acc.union_with(other); }
+};
+
+/*
+ * Meet operator for must problems: intersection of incoming sets.
+ */
+struct IntersectMeet {
+    void operator()(BitVector& acc, const BitVector& other) const { acc.intersect_with(other); }
+};
+
+/*
+ * Dataflow problem over the blocks of one function.
+ *
+ * Template args:
+ * - Dir: Direction::Forward computes OUT from IN, Direction::Backward computes IN from OUT.
+ * - Domain: value attached to the entry and exit of each block; must be copyable.
+ * - Transfer: callable bool(size_t b, const Domain& input, Domain& output) returning whether output changed.
+ * - Meet: callable void(Domain& acc, const Domain& other) combining other into acc.
+ */
+template <Direction Dir, typename Domain, typename Transfer, typename Meet>
+class Dataflow {
+public:
+    Dataflow(const std::vector<std::vector<size_t>>& preds, const std::vector<std::vector<size_t>>& succs, const Domain& top, const Domain& boundary, Transfer transfer, Meet meet);
+
+    size_t solve(void);
+
+    const std::vector<Domain>& get_in(void) const { return in; }
+    const std::vector<Domain>& get_out(void) const { return out; }
+
+private:
+    const std::vector<std::vector<size_t>>& preds;
+    const std::vector<std::vector<size_t>>& succs;
+    Domain top;
+    Domain boundary;
+    Transfer transfer;
+    Meet meet;
+    std::vector<Domain> in;
+    std::vector<Domain> out;
+};
+
+/*
+ * Constructs a dataflow problem.
+ *
+ * Args:
+ * - preds: predecessor block numbers of each block.
+ * - succs: successor block numbers of each block.
+ * - top: identity of the meet operator; initial value of every set.
+ * - boundary: value flowing into blocks without predecessors (forward) or successors (backward).
+ * - transfer: transfer function.
+ * - meet: meet operator.
+ */
+template <Direction Dir, typename Domain, typename Transfer, typename Meet>
+Dataflow<Dir, Domain, Transfer, Meet>::Dataflow(const std::vector<std::vector<size_t>>& preds, const std::vector<std::vector<size_t>>& succs, const Domain& top, const Domain& boundary, Transfer transfer, Meet meet)
+    : preds(preds), succs(succs), top(top), boundary(boundary), transfer(transfer), meet(meet) {
+    in.assign(preds.size(), top);
+    out.assign(preds.size(), top);
+}
+
+/*
+ * Iterates to a fixed point.
+ * Forward problems visit the lowest-numbered pending block first (reverse post-order), backward problems the highest (post-order).
+ * Only the neighbours of a block whose result changed are re-enqueued.
+ *
+ * Returns:
+ * - Number of block visits made.
+ */
+template <Direction Dir, typename Domain, typename Transfer, typename Meet>
+size_t Dataflow<Dir, Domain, Transfer, Meet>::solve(void) {
+    std::set<size_t> worklist;
+    std::set<size_t>::iterator work_it;
+    std::vector<size_t>::const_iterator bb_it;
+    size_t b, visits;
+
+    // Every block is visited at least once.
+    for (b = 0; b < preds.size(); b++) worklist.insert(b);
+
+    visits = 0;
+    while (!worklist.empty()) {
+        if constexpr (Dir == Direction::Forward) work_it = worklist.begin();
+        else work_it = std::prev(worklist.end());
+        b = *work_it;
+        worklist.erase(work_it);
+        visits++;
+
+        if constexpr (Dir == Direction::Forward) {
+            // IN set is meet of OUT sets of all predecessors.
+            if (preds[b].empty()) in[b] = boundary;
+            else {
+                in[b] = top;
+                for (bb_it = preds[b].begin(); bb_it != preds[b].end(); ++bb_it) meet(in[b], out[*bb_it]);
+            }
+
+            // Successors must be revisited if OUT set changed.
+            if (transfer(b, in[b], out[b]))
+                for (bb_it = succs[b].begin(); bb_it != succs[b].end(); ++bb_it) worklist.insert(*bb_it);
+        } else {
+            // OUT set is meet of IN sets of all successors.
+            if (succs[b].empty()) out[b] = boundary;
+            else {
+                out[b] = top;
+                for (bb_it = succs[b].begin(); bb_it != succs[b].end(); ++bb_it) meet(out[b], in[*bb_it]);
+            }
+
+            // Predecessors must be revisited if IN set changed.
+            if (transfer(b, out[b], in[b]))
+                for (bb_it = preds[b].begin(); bb_it != preds[b].end(); ++bb_it) worklist.insert(*bb_it);
+        }
+    }
+
+    return visits;
+}
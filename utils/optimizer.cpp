@@ -11,6 +11,19 @@
  * - constant folding
  * - constants propagation
  * - live variable analysis
+ * - memory to register promotion
+ * - global value numbering
+ * - loop-invariant code motion
+ * - induction variable strength reduction
+ * - closed forms of counting loops
+ * - sparse conditional constant propagation
+ * - control-flow graph simplification
+ * - instruction combining
+ * - dead store and dead alloca elimination
+ * - aggressive dead code elimination
+ * - a pass registry with configurable pipelines, -O levels, per-pass switches and an iteration cap
+ * - time and fuel budgets that stop optimization early with a valid module
+ * - statistics for every pass and an optional YAML remarks file of each transformation
  *
  * Citations:
  * - ChatGPT for help with move assignment (to avoid segfault in main)
@@ -25,400 +38,761 @@
 #include <iostream>
 #include <filesystem>
 #include <optional>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 
 /*
- * Given a set of load or storeinstructions and an operand, checks to see if there are loads or stores to the same location in the set.
+ * Value number key of an instruction: opcode, comparison predicate and operands.
+ * Two instructions with equal keys compute the same value as long as no store intervenes between two loads.
+ */
+struct ExprKey {
+    LLVMOpcode op;
+    int pred;
+    std::vector<LLVMValueRef> operands;
+
+    bool operator==(const ExprKey& other) const { return op == other.op && pred == other.pred && operands == other.operands; }
+};
+
+/*
+ * Hashes an expression key by combining the hashes of its fields.
+ */
+struct ExprKeyHash {
+    size_t operator()(const ExprKey& key) const {
+        std::vector<LLVMValueRef>::const_iterator it;
+        size_t h;
+
+        h = std::hash<int>()(key.op) * 31 + std::hash<int>()(key.pred);
+        for (it = key.operands.begin(); it != key.operands.end(); ++it) h = h * 31 + std::hash<LLVMValueRef>()(*it);
+
+        return h;
+    }
+};
+
+/*
+ * Builds the value number key of an instruction.
  *
  * Args:
- * - set: set of load or store instructions.
- * - operand: location to search for
+ * - i: instruction whose key to build.
  *
  * Returns:
- * - Set of instructions to same location as operand
+ * - Key of the instruction.
  */
-static std::set<LLVMValueRef> find_instrs_with_operand(std::set<LLVMValueRef>& set, LLVMValueRef operand) {
-    std::set<LLVMValueRef>::iterator set_it;
-    std::set<LLVMValueRef> matches;
+static ExprKey make_expr_key(LLVMValueRef i) {
+    ExprKey key;
+    int k;
 
-    for (set_it = set.begin(); set_it != set.end(); ++set_it) {
-        if (LLVMGetInstructionOpcode(*set_it) == LLVMStore) {
-            if (operand == LLVMGetOperand(*set_it, 1)) matches.insert(*set_it);
-        } else if (LLVMGetInstructionOpcode(*set_it) == LLVMLoad) {
-            if (operand == LLVMGetOperand(*set_it, 0)) matches.insert(*set_it);
-        }
-    }
+    key.op = LLVMGetInstructionOpcode(i);
+    key.pred = key.op == LLVMICmp ? LLVMGetICmpPredicate(i) : 0;
+    for (k = 0; k < LLVMGetNumOperands(i); k++) key.operands.push_back(LLVMGetOperand(i, k));
+
+    return key;
+}
+
+/*
+ * Checks whether an instruction may be replaced by an earlier instruction with the same key.
+ * Calls, stores, terminators, allocas and phis are never eliminated.
+ */
+static bool is_value_numbered(LLVMValueRef i) {
+    LLVMOpcode op;
 
-    return matches;
+    op = LLVMGetInstructionOpcode(i);
+    return op != LLVMCall && op != LLVMStore && !LLVMIsATerminatorInst(i) && op != LLVMAlloca && op != LLVMPHI;
 }
 
 /*
- * Computes GEN set for all basic blocks of a function using forward analysd analysis.
- * GEN sets take the form of a map from basic block references to sets of instructions.
+ * Creates a preheader for a loop: a new block before the header that all outside predecessors branch to instead.
+ * Header phis are rebuilt so that outside incoming values arrive through the preheader, merged by a phi there when
+ * there is more than one outside predecessor.
  *
  * Args:
- * - f: function for which to compute set.
+ * - loop: loop without a dedicated preheader.
+ * - preds: predecessor lists for all blocks.
  *
  * Returns:
- * - Computed GEN set, nullopt if failure
+ * - The new preheader.
  */
-static std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>> compute_gen_fa(LLVMValueRef f) {
-    LLVMValueRef i;
-    LLVMBasicBlockRef bb;
-    std::set<LLVMValueRef> instrs;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> gen_fa;
-
-    if (f == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
+static LLVMBasicBlockRef insert_preheader(const Loop& loop, const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& preds) {
+    LLVMBasicBlockRef pre, in_bb;
+    LLVMBuilderRef b;
+    LLVMValueRef i, next, term, phi, pre_phi, val;
+    std::vector<LLVMBasicBlockRef> outside;
+    std::vector<LLVMBasicBlockRef>::const_iterator pred_it;
+    std::vector<LLVMValueRef> outside_vals;
+    unsigned int k;
+
+    for (pred_it = preds.at(loop.header).begin(); pred_it != preds.at(loop.header).end(); ++pred_it)
+        if (!loop.block_set.contains(*pred_it)) outside.push_back(*pred_it);
+
+    pre = LLVMInsertBasicBlock(loop.header, "");
+    b = LLVMCreateBuilder();
+    LLVMPositionBuilderAtEnd(b, pre);
+    LLVMBuildBr(b, loop.header);
+
+    // Outside predecessors now enter the loop through the preheader.
+    for (pred_it = outside.begin(); pred_it != outside.end(); ++pred_it) {
+        term = LLVMGetBasicBlockTerminator(*pred_it);
+        for (k = 0; k < LLVMGetNumSuccessors(term); k++)
+            if (LLVMGetSuccessor(term, k) == loop.header) LLVMSetSuccessor(term, k, pre);
     }
 
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Create an empty gen set for basic block.
-        gen_fa.insert({bb, std::set<LLVMValueRef>()});
-
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-            // Only add store instructions to GEN set.
-            if (LLVMGetInstructionOpcode(i) == LLVMStore) {
-                // Check if store to same operand exists in GEN set.
-                instrs = find_instrs_with_operand(gen_fa[bb], LLVMGetOperand(i, 1));
+    // Phi incoming values cannot be removed, so rebuild each header phi.
+    for (i = LLVMGetFirstInstruction(loop.header); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = next) {
+        next = LLVMGetNextInstruction(i);
+
+        // Merge the outside values in the preheader.
+        outside_vals.clear();
+        LLVMPositionBuilderBefore(b, LLVMGetBasicBlockTerminator(pre));
+        pre_phi = LLVMBuildPhi(b, LLVMTypeOf(i), "");
+        for (k = 0; k < LLVMCountIncoming(i); k++) {
+            if (loop.block_set.contains(LLVMGetIncomingBlock(i, k))) continue;
+            val = LLVMGetIncomingValue(i, k);
+            in_bb = LLVMGetIncomingBlock(i, k);
+            LLVMAddIncoming(pre_phi, &val, &in_bb, 1);
+            outside_vals.push_back(val);
+        }
+        if (outside_vals.size() == 1) {
+            LLVMInstructionEraseFromParent(pre_phi);
+            pre_phi = outside_vals[0];
+        }
 
-                // If an instruction with the given operand already exists in the set, replace it.
-                if (!instrs.empty()) {
-                    gen_fa[bb].erase(*instrs.begin());
-                    gen_fa[bb].insert(i);
-                }
-                else gen_fa[bb].insert(i);
-            }
+        // New header phi: loop values plus the merged outside value.
+        LLVMPositionBuilderBefore(b, LLVMGetFirstInstruction(loop.header));
+        phi = LLVMBuildPhi(b, LLVMTypeOf(i), "");
+        for (k = 0; k < LLVMCountIncoming(i); k++) {
+            if (!loop.block_set.contains(LLVMGetIncomingBlock(i, k))) continue;
+            val = LLVMGetIncomingValue(i, k);
+            in_bb = LLVMGetIncomingBlock(i, k);
+            LLVMAddIncoming(phi, &val, &in_bb, 1);
         }
+        LLVMAddIncoming(phi, &pre_phi, &pre, 1);
+
+        LLVMReplaceAllUsesWith(i, phi);
+        LLVMInstructionEraseFromParent(i);
     }
 
-    return gen_fa;
+    LLVMDisposeBuilder(b);
+
+    return pre;
 }
 
 /*
- * Computes KILL set for all basic blocks of a function using forwaard analysis.
- * KILL set takes the form of a map from basic block references to sets of instructions.
+ * Checks whether an instruction may be executed in a loop preheader even if the loop body would not have run it.
+ * Loads qualify only when they read an alloca that the loop never stores to.
  *
  * Args:
- * - f: function for which to compute set.
+ * - i: candidate instruction.
+ * - stored: allocas stored to inside the loop.
  *
  * Returns:
- * - Computed KILL set, nullopt if failure.
+ * - True if the instruction can be hoisted once its operands are invariant.
  */
-static std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>> compute_kill_fa(LLVMValueRef f) {
-    LLVMValueRef i, loc;
-    LLVMBasicBlockRef bb;
-    std::set<LLVMValueRef> all_stores;
-    std::set<LLVMValueRef>::iterator set_it;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> kill_fa;
-
-    if (f == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
+static bool is_hoistable(LLVMValueRef i, const std::unordered_set<LLVMValueRef>& stored) {
+    LLVMValueRef divisor;
+
+    switch (LLVMGetInstructionOpcode(i)) {
+        case LLVMAdd:
+        case LLVMSub:
+        case LLVMMul:
+        case LLVMICmp:
+            return true;
+        case LLVMSDiv:
+        case LLVMSRem:
+            // Division may trap, so only hoist it for a known non-zero, non-negative-one divisor.
+            divisor = LLVMGetOperand(i, 1);
+            return LLVMIsAConstantInt(divisor) && LLVMConstIntGetSExtValue(divisor) != 0 && LLVMConstIntGetSExtValue(divisor) != -1;
+        case LLVMLoad:
+            return LLVMIsAAllocaInst(LLVMGetOperand(i, 0)) && !stored.contains(LLVMGetOperand(i, 0));
+        default:
+            return false;
     }
+}
 
-    // Create set of all store instructions.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-            if (LLVMGetInstructionOpcode(i) == LLVMStore) all_stores.insert(i);
-        }
-    }
+/*
+ * Checks whether a value is unchanged across the iterations of a loop.
+ *
+ * Args:
+ * - v: value to check.
+ * - loop: loop in question.
+ *
+ * Returns:
+ * - True if v is a constant, an argument or an instruction outside the loop.
+ */
+static bool is_loop_invariant(LLVMValueRef v, const Loop& loop) {
+    if (LLVMIsAInstruction(v)) return !loop.block_set.contains(LLVMGetInstructionParent(v));
 
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Kill set for each basic block starts off as empty set.
-        kill_fa.insert({bb, std::set<LLVMValueRef>()});
+    return LLVMIsAConstant(v) || LLVMIsAArgument(v);
+}
 
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-            // Only add store instructions to KILL set.
-            if (LLVMGetInstructionOpcode(i) == LLVMStore) {
-                // Get store location.
-                loc = LLVMGetOperand(i, 1);
+/*
+ * Checks whether x * factor cannot overflow a 32-bit integer for any x between lo and hi.
+ */
+static bool product_fits(long long lo, long long hi, long long factor) {
+    return lo * factor >= INT32_MIN && lo * factor <= INT32_MAX && hi * factor >= INT32_MIN && hi * factor <= INT32_MAX;
+}
 
-                // Look for store instructions that are killed.
-                for (set_it = all_stores.begin(); set_it != all_stores.end(); ++set_it) {
-                    // A store cannot kill itself.
-                    if (*set_it != i && LLVMGetOperand(*set_it, 1) == loc) kill_fa[bb].insert(*set_it);
-                }
-            }
-        }
+/*
+ * Checks whether a loop that runs while its induction variable compares to a bound by pred moves the variable toward
+ * the bound, so that it never leaves the range between its start and the bound, give or take one step.
+ * With != the bound must be hit exactly, by the phi (tested from the first value) or by the update (from the second).
+ *
+ * Args:
+ * - pred: predicate that keeps the loop running, with the induction variable on the left.
+ * - init, step: start and step of the induction variable.
+ * - bound: constant it is compared against.
+ * - tests_update: whether the test reads the update rather than the phi.
+ */
+static bool moves_toward_bound(LLVMIntPredicate pred, long long init, long long step, long long bound, bool tests_update) {
+    switch (pred) {
+        case LLVMIntSLT:
+        case LLVMIntSLE:
+            return step > 0;
+        case LLVMIntSGT:
+        case LLVMIntSGE:
+            return step < 0;
+        case LLVMIntNE:
+            if (step == 0 || (bound - init) % step != 0) return false;
+            return (bound - init) / step >= (tests_update ? 1 : 0);
+        default:
+            return false;
+    }
+}
+
+/*
+ * Predicate that gives the same result with the operands swapped.
+ */
+static LLVMIntPredicate swap_predicate(LLVMIntPredicate pred) {
+    switch (pred) {
+        case LLVMIntSGT: return LLVMIntSLT;
+        case LLVMIntSGE: return LLVMIntSLE;
+        case LLVMIntSLT: return LLVMIntSGT;
+        case LLVMIntSLE: return LLVMIntSGE;
+        case LLVMIntUGT: return LLVMIntULT;
+        case LLVMIntUGE: return LLVMIntULE;
+        case LLVMIntULT: return LLVMIntUGT;
+        case LLVMIntULE: return LLVMIntUGE;
+        default: return pred;
     }
+}
 
-    return kill_fa;
+/*
+ * Predicate that gives the opposite result on the same operands.
+ */
+static LLVMIntPredicate negate_predicate(LLVMIntPredicate pred) {
+    switch (pred) {
+        case LLVMIntEQ: return LLVMIntNE;
+        case LLVMIntNE: return LLVMIntEQ;
+        case LLVMIntSGT: return LLVMIntSLE;
+        case LLVMIntSGE: return LLVMIntSLT;
+        case LLVMIntSLT: return LLVMIntSGE;
+        case LLVMIntSLE: return LLVMIntSGT;
+        case LLVMIntUGT: return LLVMIntULE;
+        case LLVMIntUGE: return LLVMIntULT;
+        case LLVMIntULT: return LLVMIntUGE;
+        case LLVMIntULE: return LLVMIntUGT;
+        default: return pred;
+    }
 }
 
 /*
- * Computes IN and OUT set for all basic blocks of a function using forward analysis.
- * IN and OUT sets take the form of a map from basic block references to sets of instructions.
+ * Loop-carried value whose back-edge value is start plus a sum of terms: x' = x + t1 - t2 + ...
+ * Each term is either loop invariant or a basic induction variable (its phi or its update).
+ */
+struct Recurrence {
+    LLVMValueRef phi;
+    LLVMValueRef start;
+    std::vector<std::pair<LLVMValueRef, bool>> terms;
+};
+
+/*
+ * Finds the induction variable whose phi or update is v.
  *
  * Args:
- * - f: function for which to compute set.
- * - gen_fa: GEN set for correspinding function.
- * - kill_fa: KILL set for corresponding function.
+ * - v: value to look up.
+ * - ivs: induction variables of the loop.
  *
  * Returns:
- * - Pair of computed in and out sets, nullopt if failure.
+ * - Pointer into ivs, or NULL if v is not an induction variable.
  */
-static std::optional<std::pair<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>>> compute_in_and_out_fa(LLVMValueRef f, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>& gen_fa, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>& kill_fa) {
-    LLVMValueRef term;
-    LLVMBasicBlockRef bb, succ;
-    std::set<LLVMBasicBlockRef>::iterator bb_it;
-    std::set<LLVMValueRef>::iterator val_it;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> preds;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> old_out, in_fa, out_fa;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>::iterator map_it;
-    bool change;
-    unsigned int num;
+static const InductionVariable* find_iv(LLVMValueRef v, const std::vector<InductionVariable>& ivs) {
+    std::vector<InductionVariable>::const_iterator iv_it;
 
-    if (f == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
-    }
+    for (iv_it = ivs.begin(); iv_it != ivs.end(); ++iv_it)
+        if (iv_it->phi == v || iv_it->update == v) return &*iv_it;
 
-    // Create empty predecessor serts for eahc block.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb))
-        preds.insert({bb, std::set<LLVMBasicBlockRef>()});
+    return NULL;
+}
 
-    // Compute predecessor sets for each basic block.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Get terminator for basic block.
-        term = LLVMGetBasicBlockTerminator(bb);
-        // Add basic block to predecessor set for each of its successors.
-        for (num = 0; num < LLVMGetNumSuccessors(term); num++) {
-            succ = LLVMGetSuccessor(term, num);
-            preds[succ].insert(bb);
-        }
+/*
+ * Expresses a header phi as a sum recurrence by walking the add/sub chain from its back-edge value back to the phi.
+ *
+ * Args:
+ * - phi: header phi.
+ * - loop: loop with a preheader and a single latch.
+ * - ivs: induction variables of the loop.
+ *
+ * Returns:
+ * - The recurrence, or nullopt if the chain contains anything other than invariant or induction variable terms.
+ */
+static std::optional<Recurrence> find_recurrence(LLVMValueRef phi, const Loop& loop, const std::vector<InductionVariable>& ivs) {
+    Recurrence rec;
+    LLVMValueRef cur, op0, op1;
+    LLVMOpcode op;
+    unsigned int k;
+
+    rec.phi = phi;
+    rec.start = NULL;
+    cur = NULL;
+    for (k = 0; k < LLVMCountIncoming(phi); k++) {
+        if (LLVMGetIncomingBlock(phi, k) == loop.preheader) rec.start = LLVMGetIncomingValue(phi, k);
+        else cur = LLVMGetIncomingValue(phi, k);
     }
-
-    // Initialize IN and OUT sets.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // IN sets start out as empty.
-        in_fa.insert({bb, std::set<LLVMValueRef>()});
-
-        // OUT set is GEN set of corresponding basic block.
-        out_fa.insert({bb, gen_fa.find(bb)->second});
+    if (LLVMCountIncoming(phi) != 2 || rec.start == NULL || cur == NULL) return std::nullopt;
+
+    while (cur != phi) {
+        if (!LLVMIsAInstruction(cur) || !loop.block_set.contains(LLVMGetInstructionParent(cur))) return std::nullopt;
+
+        op = LLVMGetInstructionOpcode(cur);
+        op0 = LLVMGetOperand(cur, 0);
+        op1 = op == LLVMAdd || op == LLVMSub ? LLVMGetOperand(cur, 1) : NULL;
+
+        if (op == LLVMAdd && op1 == phi) {
+            rec.terms.push_back(std::make_pair(op0, true));
+            cur = op1;
+        } else if (op == LLVMAdd && (is_loop_invariant(op1, loop) || find_iv(op1, ivs) != NULL)) {
+            rec.terms.push_back(std::make_pair(op1, true));
+            cur = op0;
+        } else if (op == LLVMAdd && (is_loop_invariant(op0, loop) || find_iv(op0, ivs) != NULL)) {
+            rec.terms.push_back(std::make_pair(op0, true));
+            cur = op1;
+        } else if (op == LLVMSub && (is_loop_invariant(op1, loop) || find_iv(op1, ivs) != NULL)) {
+            rec.terms.push_back(std::make_pair(op1, false));
+            cur = op0;
+        } else return std::nullopt;
     }
 
-    // Iterate until a fixed point is reached.
-    do {
-        // First update IN set.
-        for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-            // IN set is union of OUT sets of all predecessors.
-            for (bb_it = preds[bb].begin(); bb_it != preds[bb].end(); ++bb_it) {
-                for (val_it = out_fa[*bb_it].begin(); val_it != out_fa[*bb_it].end(); ++val_it) {
-                    in_fa[bb].insert(*val_it);
-                }
-            }
-        }
+    // A phi term that is the recurrence itself would make it geometric.
+    for (k = 0; k < rec.terms.size(); k++)
+        if (rec.terms[k].first == phi || (!is_loop_invariant(rec.terms[k].first, loop) && find_iv(rec.terms[k].first, ivs) == NULL)) return std::nullopt;
 
-        // Then update OUT set.
-        old_out = out_fa;
-        for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-            // Start off with empty out set.
-            out_fa[bb] = std::set<LLVMValueRef>();
+    return rec;
+}
 
-            // Out set contains GEN set of basic block.
-            for (val_it = gen_fa[bb].begin(); val_it != gen_fa[bb].end(); ++val_it) out_fa[bb].insert(*val_it);
+/*
+ * Emits m * (m - 1) / 2 modulo 2^32 without a division: one of m and m - 1 is even, so halve that one first.
+ *
+ * Args:
+ * - b: builder positioned where the code should go.
+ * - m: 32-bit count.
+ *
+ * Returns:
+ * - The triangular number.
+ */
+static LLVMValueRef build_triangular(LLVMBuilderRef b, LLVMValueRef m) {
+    LLVMValueRef one, half, odd;
 
-            // OUT set also contains union of set difference of IN set and KILL set.
-            for (val_it = in_fa[bb].begin(); val_it != in_fa[bb].end(); ++val_it)
-                // Ensure not in KILL set and not already in OUT set.
-                if (!kill_fa[bb].contains(*val_it)) out_fa[bb].insert(*val_it);
-        }
+    one = LLVMConstInt(LLVMTypeOf(m), 1, 0);
+    half = LLVMBuildLShr(b, m, one, "");
+    odd = LLVMBuildAnd(b, m, one, "");
 
-        // Check to see if out set has changed.
-        change = false;
-        for (map_it = old_out.begin(); map_it != old_out.end() && !change; ++map_it) {
-            // Check if old out and new out have the same number of statements.
-            if (map_it->second.size() != out_fa[map_it->first].size()) change = true;
-            for (val_it = map_it->second.begin(); val_it != map_it->second.end() && !change; ++val_it)
-                // Ensure that all elements in old out are in new out.
-                if (!out_fa[map_it->first].contains(*val_it)) change = true;
-        }
+    return LLVMBuildMul(b, half, LLVMBuildAdd(b, LLVMBuildSub(b, m, one, ""), odd, ""), "");
+}
 
-    } while (change);
+/*
+ * Lattice of sparse conditional constant propagation: undefined (no value seen yet), one constant, or overdefined.
+ */
+enum class LatticeKind { Undefined, Constant, Overdefined };
 
-    return std::make_pair(in_fa, out_fa);
-}
+struct LatticeValue {
+    LatticeKind kind;
+    long long value;
+};
 
 /*
- * Computes GEN set for all basic blocks of a function using reverse analysis.
- * GEN sets take the form of a map from basic block references to sets of instructions.
+ * Looks up the lattice value of an operand.
  *
  * Args:
- * - f (LLVMValueRef): function for which to compute set.
+ * - v: operand.
+ * - lattice: current values of instructions.
  *
  * Returns:
- * - Computed GEN set, nullopt if failure
+ * - Constant for integer constants, undefined for unvisited instructions, overdefined otherwise (including undef).
  */
-static std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>> compute_gen_ra(LLVMValueRef f) {
-    LLVMValueRef i;
-    LLVMBasicBlockRef bb;
-    std::set<LLVMValueRef> stores;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> gen_ra;
-
-    if (f == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
-    }
+static LatticeValue get_lattice(LLVMValueRef v, const std::unordered_map<LLVMValueRef, LatticeValue>& lattice) {
+    std::unordered_map<LLVMValueRef, LatticeValue>::const_iterator it;
 
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Create set of all store locations in this basic block.
-        stores = std::set<LLVMValueRef>();
+    if (LLVMIsAConstantInt(v)) return LatticeValue{LatticeKind::Constant, LLVMConstIntGetSExtValue(v)};
+    if (!LLVMIsAInstruction(v)) return LatticeValue{LatticeKind::Overdefined, 0};
+    if ((it = lattice.find(v)) == lattice.end()) return LatticeValue{LatticeKind::Undefined, 0};
 
-        // Create an empty gen set for this basic block.
-        gen_ra.insert({bb, std::set<LLVMValueRef>()});
+    return it->second;
+}
 
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i))
-            // Only add load instructions for which no store instructions exist in the same basic block to GEN set.
-            if (LLVMGetInstructionOpcode(i) == LLVMLoad && !stores.contains(LLVMGetOperand(i, 0))) gen_ra[bb].insert(i);
-            // Add store instructions to set of stores.
-            else if (LLVMGetInstructionOpcode(i) == LLVMStore) stores.insert(LLVMGetOperand(i, 1));
-    }
+/*
+ * Meet of two lattice values.
+ */
+static LatticeValue meet_lattice(LatticeValue a, LatticeValue b) {
+    if (a.kind == LatticeKind::Undefined) return b;
+    if (b.kind == LatticeKind::Undefined) return a;
+    if (a.kind == LatticeKind::Constant && b.kind == LatticeKind::Constant && a.value == b.value) return a;
 
-    return gen_ra;
+    return LatticeValue{LatticeKind::Overdefined, 0};
 }
 
 /*
- * Computes KILL set for all basic blocks of a function using reverse analysis.
- * KILL set takes the form of a map from basic block references to sets of instructions.
+ * Folds a 32-bit integer operation with wrap-around semantics.
  *
  * Args:
- * - f (LLVMValueRef): function for which to compute set.
+ * - i: add, sub, mul, sdiv, srem, and, shl, lshr or icmp instruction.
+ * - a, b: constant operands.
+ * - result: set to the folded value (0 or 1 for comparisons).
  *
  * Returns:
- * - Computed KILL set, nullopt if failure
+ * - False if the operation cannot be folded (division by zero or overflow, unknown opcode).
  */
-static std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>> compute_kill_ra(LLVMValueRef f) {
-    LLVMValueRef i, loc;
-    LLVMBasicBlockRef bb;
-    std::set<LLVMValueRef> all_loads;
-    std::set<LLVMValueRef>::iterator it;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> kill_ra;
-
-    if (f == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
+static bool fold_binary(LLVMValueRef i, long long a, long long b, long long& result) {
+    int32_t x, y;
+
+    x = (int32_t)a;
+    y = (int32_t)b;
+
+    switch (LLVMGetInstructionOpcode(i)) {
+        case LLVMAdd:
+            result = (int32_t)((uint32_t)x + (uint32_t)y);
+            return true;
+        case LLVMSub:
+            result = (int32_t)((uint32_t)x - (uint32_t)y);
+            return true;
+        case LLVMMul:
+            result = (int32_t)((uint32_t)x * (uint32_t)y);
+            return true;
+        case LLVMSDiv:
+        case LLVMSRem:
+            if (y == 0 || (x == INT32_MIN && y == -1)) return false;
+            result = LLVMGetInstructionOpcode(i) == LLVMSDiv ? x / y : x % y;
+            return true;
+        case LLVMAnd:
+            result = x & y;
+            return true;
+        case LLVMShl:
+        case LLVMLShr:
+            if (y < 0 || y > 31) return false;
+            result = LLVMGetInstructionOpcode(i) == LLVMShl ? (int32_t)((uint32_t)x << y) : (int32_t)((uint32_t)x >> y);
+            return true;
+        case LLVMICmp:
+            switch (LLVMGetICmpPredicate(i)) {
+                case LLVMIntEQ: result = x == y; return true;
+                case LLVMIntNE: result = x != y; return true;
+                case LLVMIntSGT: result = x > y; return true;
+                case LLVMIntSGE: result = x >= y; return true;
+                case LLVMIntSLT: result = x < y; return true;
+                case LLVMIntSLE: result = x <= y; return true;
+                case LLVMIntUGT: result = (uint32_t)x > (uint32_t)y; return true;
+                case LLVMIntUGE: result = (uint32_t)x >= (uint32_t)y; return true;
+                case LLVMIntULT: result = (uint32_t)x < (uint32_t)y; return true;
+                case LLVMIntULE: result = (uint32_t)x <= (uint32_t)y; return true;
+                default: return false;
+            }
+        default:
+            return false;
     }
+}
 
-   // Create set of all loads instructions in program.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-            if (LLVMGetInstructionOpcode(i) == LLVMLoad) all_loads.insert(i);
+/*
+ * Removes the incoming entries for one predecessor from the phis of a block.
+ * Phi incoming values cannot be removed in place, so each phi is rebuilt without them.
+ *
+ * Args:
+ * - bb: block whose phis are updated.
+ * - pred: predecessor that no longer branches to bb.
+ */
+static void remove_phi_incoming(LLVMBasicBlockRef bb, LLVMBasicBlockRef pred) {
+    LLVMBuilderRef b;
+    LLVMValueRef i, next, phi, val;
+    LLVMBasicBlockRef in_bb;
+    unsigned int k;
+
+    b = LLVMCreateBuilder();
+
+    for (i = LLVMGetFirstInstruction(bb); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = next) {
+        next = LLVMGetNextInstruction(i);
+
+        LLVMPositionBuilderBefore(b, i);
+        phi = LLVMBuildPhi(b, LLVMTypeOf(i), "");
+        for (k = 0; k < LLVMCountIncoming(i); k++) {
+            if (LLVMGetIncomingBlock(i, k) == pred) continue;
+            val = LLVMGetIncomingValue(i, k);
+            in_bb = LLVMGetIncomingBlock(i, k);
+            LLVMAddIncoming(phi, &val, &in_bb, 1);
         }
-    }
-
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Create an empty kill set for this basic block.
-        kill_ra.insert({bb, std::set<LLVMValueRef>()});
-
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-            if (LLVMGetInstructionOpcode(i) == LLVMStore) {
-                // Get store location.
-                loc = LLVMGetOperand(i, 1);
 
-                // Look for load instructuons that are killed by this store.
-                for (it = all_loads.begin(); it != all_loads.end(); ++it) 
-                    // Add such loads to kill set.
-                    if (LLVMGetOperand(*it, 0) == loc) kill_ra[bb].insert(*it);
-            }
-        }
+        LLVMReplaceAllUsesWith(i, phi);
+        LLVMInstructionEraseFromParent(i);
     }
 
-    return kill_ra;
+    LLVMDisposeBuilder(b);
 }
 
 /*
- * Computes IN and OUT set for all basic blocks of a function using reverse analysis.
- * IN and OUT sets take the form of a map from basic block references to sets of instructions.
+ * Collects the distinct blocks whose terminators branch to a block.
  *
  * Args:
- * - f (LLVMValueRef): function for which to compute set.
- * - gen_ra: GEN set for correspinding function.
- * - kill_ra: KILL set for corresponding function.
+ * - bb: block in question.
  *
  * Returns:
- * - Pair of computed in and out sets, nullopt if failure.
+ * - Predecessors of bb, in use-list order.
  */
-static std::optional<std::pair<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>>> compute_in_and_out_ra(LLVMValueRef f, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>& gen_ra, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>& kill_ra) {
-    LLVMValueRef term;
-    LLVMBasicBlockRef bb, succ;
-    std::set<LLVMBasicBlockRef>::iterator bb_it;
-    std::set<LLVMValueRef>::iterator val_it;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> succs;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> old_in, in_ra, out_ra;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>::iterator map_it;
-    bool change;
-    unsigned int num;
-
-    if (f == NULL) {
-        std::cerr << "Invalid argument to function.\n";
-        return std::nullopt;
+static std::vector<LLVMBasicBlockRef> get_predecessors(LLVMBasicBlockRef bb) {
+    std::vector<LLVMBasicBlockRef> preds;
+    LLVMUseRef use;
+    LLVMBasicBlockRef pred;
+
+    for (use = LLVMGetFirstUse(LLVMBasicBlockAsValue(bb)); use != NULL; use = LLVMGetNextUse(use)) {
+        if (!LLVMIsATerminatorInst(LLVMGetUser(use))) continue;
+        pred = LLVMGetInstructionParent(LLVMGetUser(use));
+        if (std::find(preds.begin(), preds.end(), pred) == preds.end()) preds.push_back(pred);
     }
 
-   // Compute successor sets for each basic block.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        succs.insert({bb, std::set<LLVMBasicBlockRef>()});
+    return preds;
+}
 
-        // Get terminator for basic block.
-        term = LLVMGetBasicBlockTerminator(bb);
+/*
+ * Marks an instruction live for aggressive dead code elimination, queueing it the first time.
+ * Values that are not instructions (constants, arguments, blocks) need no marking.
+ */
+static void mark_live(LLVMValueRef v, std::unordered_set<LLVMValueRef>& live, std::vector<LLVMValueRef>& worklist) {
+    if (!LLVMIsAInstruction(v) || live.contains(v)) return;
 
-        // Add basic block to predecessor set for each of its successors.
-        for (num = 0; num < LLVMGetNumSuccessors(term); num++) {
-            succ = LLVMGetSuccessor(term, num);
-            succs[bb].insert(succ);
-        }
-    }
+    live.insert(v);
+    worklist.push_back(v);
+}
 
-    // Initialize IN and OUT sets.
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // OUT sets start out as empty.
-        out_ra.insert({bb, std::set<LLVMValueRef>()});
+/*
+ * Checks whether a value is the integer constant c.
+ */
+static bool is_const_value(LLVMValueRef v, long long c) {
+    return LLVMIsAConstantInt(v) && LLVMConstIntGetSExtValue(v) == c;
+}
+
+/*
+ * Peephole rewrite rules. Each rule gets an instruction and a builder positioned before it and returns NULL if it
+ * does not apply, the instruction itself if it changed it in place, or the value that replaces it.
+ */
+static LLVMValueRef rule_commute_constant_right(LLVMValueRef i, LLVMBuilderRef b) {
+    LLVMValueRef lhs;
+
+    if (LLVMGetInstructionOpcode(i) != LLVMAdd && LLVMGetInstructionOpcode(i) != LLVMMul && LLVMGetInstructionOpcode(i) != LLVMAnd) return NULL;
+    if (!LLVMIsConstant(LLVMGetOperand(i, 0)) || LLVMIsConstant(LLVMGetOperand(i, 1))) return NULL;
+
+    lhs = LLVMGetOperand(i, 0);
+    LLVMSetOperand(i, 0, LLVMGetOperand(i, 1));
+    LLVMSetOperand(i, 1, lhs);
+
+    return i;
+}
+
+static LLVMValueRef rule_icmp_constant_right(LLVMValueRef i, LLVMBuilderRef b) {
+    if (LLVMGetInstructionOpcode(i) != LLVMICmp || !LLVMIsConstant(LLVMGetOperand(i, 0)) || LLVMIsConstant(LLVMGetOperand(i, 1))) return NULL;
+
+    return LLVMBuildICmp(b, swap_predicate(LLVMGetICmpPredicate(i)), LLVMGetOperand(i, 1), LLVMGetOperand(i, 0), "");
+}
+
+static LLVMValueRef rule_add_zero(LLVMValueRef i, LLVMBuilderRef b) {
+    if (LLVMGetInstructionOpcode(i) != LLVMAdd || !is_const_value(LLVMGetOperand(i, 1), 0)) return NULL;
+
+    return LLVMGetOperand(i, 0);
+}
+
+static LLVMValueRef rule_sub_zero(LLVMValueRef i, LLVMBuilderRef b) {
+    if (LLVMGetInstructionOpcode(i) != LLVMSub || !is_const_value(LLVMGetOperand(i, 1), 0)) return NULL;
+
+    return LLVMGetOperand(i, 0);
+}
+
+static LLVMValueRef rule_sub_self(LLVMValueRef i, LLVMBuilderRef b) {
+    if (LLVMGetInstructionOpcode(i) != LLVMSub || LLVMGetOperand(i, 0) != LLVMGetOperand(i, 1)) return NULL;
+
+    return LLVMConstInt(LLVMTypeOf(i), 0, 0);
+}
+
+static LLVMValueRef rule_double_negation(LLVMValueRef i, LLVMBuilderRef b) {
+    LLVMValueRef inner;
+
+    if (LLVMGetInstructionOpcode(i) != LLVMSub || !is_const_value(LLVMGetOperand(i, 0), 0)) return NULL;
+
+    inner = LLVMGetOperand(i, 1);
+    if (!LLVMIsAInstruction(inner) || LLVMGetInstructionOpcode(inner) != LLVMSub || !is_const_value(LLVMGetOperand(inner, 0), 0)) return NULL;
+
+    return LLVMGetOperand(inner, 1);
+}
+
+static LLVMValueRef rule_mul_zero(LLVMValueRef i, LLVMBuilderRef b) {
+    if ((LLVMGetInstructionOpcode(i) != LLVMMul && LLVMGetInstructionOpcode(i) != LLVMAnd) || !is_const_value(LLVMGetOperand(i, 1), 0)) return NULL;
+
+    return LLVMConstInt(LLVMTypeOf(i), 0, 0);
+}
+
+static LLVMValueRef rule_mul_one(LLVMValueRef i, LLVMBuilderRef b) {
+    if ((LLVMGetInstructionOpcode(i) != LLVMMul && LLVMGetInstructionOpcode(i) != LLVMSDiv) || !is_const_value(LLVMGetOperand(i, 1), 1)) return NULL;
+
+    return LLVMGetOperand(i, 0);
+}
 
-        // IN set is GEN set of corresponding basic block.
-        in_ra.insert({bb, gen_ra.find(bb)->second});
+static LLVMValueRef rule_mul_minus_one(LLVMValueRef i, LLVMBuilderRef b) {
+    if (LLVMGetInstructionOpcode(i) != LLVMMul || !is_const_value(LLVMGetOperand(i, 1), -1)) return NULL;
+
+    return LLVMBuildSub(b, LLVMConstInt(LLVMTypeOf(i), 0, 0), LLVMGetOperand(i, 0), "");
+}
+
+static LLVMValueRef rule_add_negation(LLVMValueRef i, LLVMBuilderRef b) {
+    LLVMValueRef x, neg;
+    int k;
+
+    if (LLVMGetInstructionOpcode(i) != LLVMAdd) return NULL;
+
+    for (k = 0; k < 2; k++) {
+        x = LLVMGetOperand(i, k);
+        neg = LLVMGetOperand(i, 1 - k);
+        if (LLVMIsAInstruction(neg) && LLVMGetInstructionOpcode(neg) == LLVMSub && is_const_value(LLVMGetOperand(neg, 0), 0) && LLVMGetOperand(neg, 1) == x)
+            return LLVMConstInt(LLVMTypeOf(i), 0, 0);
     }
 
-    // Iterate until a fixed point is reached.
-    do {
-        // First update OUT set.
-        for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-            // OUT set is union of IN sets of all successors.
-            for (bb_it = succs[bb].begin(); bb_it != succs[bb].end(); ++bb_it) {
-                for (val_it = in_ra[*bb_it].begin(); val_it != in_ra[*bb_it].end(); ++val_it) {
-                    out_ra[bb].insert(*val_it);
-                }
-            }
-        }
+    return NULL;
+}
 
-        // Then update IN set.
-        old_in = in_ra;
-        for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-            // IN set contains GEN set of basic block.
-            for (val_it = gen_ra[bb].begin(); val_it != gen_ra[bb].end(); ++val_it)
-                    in_ra[bb].insert(*val_it);
+static LLVMValueRef rule_mul_pow2_to_shl(LLVMValueRef i, LLVMBuilderRef b) {
+    long long c;
+    int k;
 
-            // IN set also contains union of set difference of OUT set and KILL set.
-            for (val_it = out_ra[bb].begin(); val_it != out_ra[bb].end(); ++val_it)
-                // Ensure not in KILL set.
-                if (!kill_ra[bb].contains(*val_it))
-                    in_ra[bb].insert(*val_it);
-        }
+    if (LLVMGetInstructionOpcode(i) != LLVMMul || !LLVMIsAConstantInt(LLVMGetOperand(i, 1))) return NULL;
 
-        // Check whether IN set has changed.
-        change = false;
-        for (map_it = old_in.begin(); map_it != old_in.end() && !change; ++map_it) {
-            // Check if old in and new in have the same number of statements.
-            if (map_it->second.size() != in_ra[map_it->first].size()) change = true;
-            for (val_it = map_it->second.begin(); val_it != map_it->second.end() && !change; ++val_it)
-                // Ensure that all elements in old in are in new in.
-                if (!in_ra[map_it->first].contains(*val_it)) change = true;
-        }
+    c = LLVMConstIntGetSExtValue(LLVMGetOperand(i, 1));
+    if (c <= 1 || (c & (c - 1)) != 0) return NULL;
+    for (k = 0; (1LL << k) != c; k++);
 
-    } while (change);
+    return LLVMBuildShl(b, LLVMGetOperand(i, 0), LLVMConstInt(LLVMTypeOf(i), k, 0), "");
+}
+
+static LLVMValueRef rule_icmp_self(LLVMValueRef i, LLVMBuilderRef b) {
+    LLVMIntPredicate pred;
+
+    if (LLVMGetInstructionOpcode(i) != LLVMICmp || LLVMGetOperand(i, 0) != LLVMGetOperand(i, 1)) return NULL;
+
+    pred = LLVMGetICmpPredicate(i);
+
+    return LLVMConstInt(LLVMTypeOf(i), pred == LLVMIntEQ || pred == LLVMIntSGE || pred == LLVMIntSLE || pred == LLVMIntUGE || pred == LLVMIntULE, 0);
+}
+
+static LLVMValueRef rule_sub_constant_to_add(LLVMValueRef i, LLVMBuilderRef b) {
+    long long c;
+
+    if (LLVMGetInstructionOpcode(i) != LLVMSub || !LLVMIsAConstantInt(LLVMGetOperand(i, 1)) || LLVMIsConstant(LLVMGetOperand(i, 0))) return NULL;
+
+    c = LLVMConstIntGetSExtValue(LLVMGetOperand(i, 1));
+    if (c == 0 || c == INT32_MIN) return NULL;
+
+    return LLVMBuildAdd(b, LLVMGetOperand(i, 0), LLVMConstInt(LLVMTypeOf(i), -c, 1), "");
+}
+
+static LLVMValueRef rule_reassociate_constants(LLVMValueRef i, LLVMBuilderRef b) {
+    LLVMValueRef inner;
+    LLVMOpcode op;
+
+    op = LLVMGetInstructionOpcode(i);
+    if ((op != LLVMAdd && op != LLVMMul) || !LLVMIsAConstantInt(LLVMGetOperand(i, 1))) return NULL;
+
+    // Only when the inner instruction dies, so the count never grows.
+    inner = LLVMGetOperand(i, 0);
+    if (!LLVMIsAInstruction(inner) || LLVMGetInstructionOpcode(inner) != op || !LLVMIsAConstantInt(LLVMGetOperand(inner, 1))) return NULL;
+    if (LLVMGetNextUse(LLVMGetFirstUse(inner)) != NULL) return NULL;
+
+    if (op == LLVMAdd) return LLVMBuildAdd(b, LLVMGetOperand(inner, 0), LLVMConstAdd(LLVMGetOperand(inner, 1), LLVMGetOperand(i, 1)), "");
 
-    return std::make_pair(in_ra, out_ra);
+    return LLVMBuildMul(b, LLVMGetOperand(inner, 0), LLVMConstMul(LLVMGetOperand(inner, 1), LLVMGetOperand(i, 1)), "");
 }
 
+/*
+ * Rule table, applied in order; canonicalisation comes first so that the other rules only look at one operand order.
+ */
+static const std::pair<const char*, LLVMValueRef (*)(LLVMValueRef, LLVMBuilderRef)> instcombine_rules[] = {
+    {"commute-constant-right", rule_commute_constant_right},
+    {"icmp-constant-right", rule_icmp_constant_right},
+    {"add-zero", rule_add_zero},
+    {"sub-zero", rule_sub_zero},
+    {"sub-self", rule_sub_self},
+    {"double-negation", rule_double_negation},
+    {"mul-zero", rule_mul_zero},
+    {"mul-one", rule_mul_one},
+    {"mul-minus-one", rule_mul_minus_one},
+    {"add-negation", rule_add_negation},
+    {"icmp-self", rule_icmp_self},
+    {"sub-constant-to-add", rule_sub_constant_to_add},
+    {"reassociate-constants", rule_reassociate_constants},
+    {"mul-pow2-to-shl", rule_mul_pow2_to_shl},
+};
+
+/*
+ * Counts the instructions of a basic block.
+ */
+static size_t count_instructions(LLVMBasicBlockRef bb) {
+    LLVMValueRef i;
+    size_t n;
+
+    n = 0;
+    for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) n++;
+
+    return n;
+}
+
+/*
+ * Counts the instructions of a function.
+ */
+static size_t count_instructions(LLVMValueRef f) {
+    LLVMBasicBlockRef bb;
+    size_t n;
+
+    n = 0;
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) n += count_instructions(bb);
+
+    return n;
+}
+
+/*
+ * All passes a pipeline may name, in no particular order.
+ */
+const Optimizer::PassInfo Optimizer::pass_registry[] = {
+    {"simplifycfg", NULL, &Optimizer::simplify_cfg, false},
+    {"cse", &Optimizer::common_sub_expr_elim, NULL, false},
+    {"dce", &Optimizer::dead_code_elim, NULL, false},
+    {"constfold", &Optimizer::constant_folding, NULL, false},
+    {"constprop", NULL, &Optimizer::constant_propagation, true},
+    {"licm", NULL, &Optimizer::loop_invariant_code_motion, false},
+    {"dse", NULL, &Optimizer::dead_store_elimination, false},
+    {"adce", NULL, &Optimizer::aggressive_dead_code_elim, false},
+    {"lva", NULL, &Optimizer::run_live_variable_analysis, false},
+    {"mem2reg", NULL, &Optimizer::mem_to_reg, false},
+    {"sccp", NULL, &Optimizer::sparse_conditional_constant_propagation, false},
+    {"instcombine", NULL, &Optimizer::instruction_combining, false},
+    {"gvn", NULL, &Optimizer::global_value_numbering, false},
+    {"strength-reduce", NULL, &Optimizer::strength_reduction, false},
+    {"scev", NULL, &Optimizer::scalar_evolution, false},
+};
+
+const size_t Optimizer::num_passes = sizeof(pass_registry) / sizeof(pass_registry[0]);
+
+/*
+ * Predefined pipelines for -O0, -O1 and -O2.
+ * Stages are separated by semicolons and run one after another; the passes of a stage iterate to a fixed point.
+ * -O1 cleans up memory form cheaply and promotes to SSA; -O2 adds the loop, value numbering and dead code passes.
+ */
+static const char* opt_level_pipelines[] = {
+    "",
+    "simplifycfg;cse,dce,constfold,constprop,dse;lva;mem2reg;sccp,simplifycfg,cse,dce",
+    "simplifycfg;cse,dce,constfold,constprop,licm,dse,adce;lva;mem2reg;sccp,simplifycfg,instcombine,gvn,licm,strength-reduce,scev,adce,cse,dce",
+};
 
 /*
  * Default constructor for Optimizer object.
@@ -428,6 +802,15 @@ static std::optional<std::pair<std::unordered_map<LLVMBasicBlockRef, std::set<LL
  */
 Optimizer::Optimizer(void) {
     m = NULL;
+    remarks_enabled = false;
+    stores_dirty = false;
+    max_iterations = 0;
+    time_budget_ms = 0;
+    fuel = 0;
+    fuel_used = 0;
+    dataflow_visits_start = 0;
+    exhausted = false;
+    set_opt_level(2);
 }
 
 /*
@@ -450,6 +833,15 @@ Optimizer::Optimizer(std::string& fname) {
     lmb = NULL;
     err = NULL;
     m = NULL;
+    remarks_enabled = false;
+    stores_dirty = false;
+    max_iterations = 0;
+    time_budget_ms = 0;
+    fuel = 0;
+    fuel_used = 0;
+    dataflow_visits_start = 0;
+    exhausted = false;
+    set_opt_level(2);
 
     // Create LLVM module with file contents.
     if (LLVMCreateMemoryBufferWithContentsOfFile(fname.c_str(), &lmb, &err) != 0) {
@@ -481,6 +873,16 @@ Optimizer::Optimizer(std::string& fname) {
  * - invalid_argument: non-existent module provided as argument.
  */
 Optimizer::Optimizer(LLVMModuleRef m) {
+    remarks_enabled = false;
+    stores_dirty = false;
+    max_iterations = 0;
+    time_budget_ms = 0;
+    fuel = 0;
+    fuel_used = 0;
+    dataflow_visits_start = 0;
+    exhausted = false;
+    set_opt_level(2);
+
     if (m == NULL)
         std::invalid_argument("Invalid argument to function.\n");
 
@@ -515,6 +917,24 @@ Optimizer& Optimizer::operator=(Optimizer&& other) {
 
         m = other.m;
         other.m = NULL;
+        am = std::move(other.am);
+        other.am.clear();
+        stats = other.stats;
+        remarks_enabled = other.remarks_enabled;
+        remarks = other.remarks;
+        dirty_blocks = std::move(other.dirty_blocks);
+        stores_dirty = other.stores_dirty;
+        pipeline = other.pipeline;
+        pass_enabled = other.pass_enabled;
+        max_iterations = other.max_iterations;
+        unassigned = other.unassigned;
+        time_budget_ms = other.time_budget_ms;
+        fuel = other.fuel;
+        fuel_used = other.fuel_used;
+        dataflow_visits_start = other.dataflow_visits_start;
+        deadline = other.deadline;
+        exhausted = other.exhausted;
+        skipped_passes = other.skipped_passes;
     }
 
     return *this;
@@ -536,64 +956,260 @@ void Optimizer::write_to_file(std::string& fname) {
 }
 
 /*
- * Performs all optimizations on program
- * Optimizations include:
- * - Common subexpression elimination
- * - Dead code eliminiation
- * - Constant folding
- * - Constant propagation
- * - Live variable analysis.
- *
- * Optimizes until reaching a fixed point.
+ * Runs the configured pipeline (by default -O2) on every function.
+ * Each stage runs on all functions before the next stage starts, so that e.g. every function is in memory form for
+ * live variable analysis and in SSA form afterwards.
+ * Once a time or fuel budget runs out, remaining pass runs are skipped and recorded; every pass leaves valid IR, so the
+ * module is valid at whatever point optimization stopped.
  *
  * Returns:
- * - -1 on failure, otherwise number of unassigned variables
+ * - -1 on failure, otherwise number of unassigned variables found by live variable analysis (0 if it did not run)
  */
 int Optimizer::optimize(void) {
     LLVMValueRef f;
-    LLVMBasicBlockRef bb;
-    bool sec, dce, cf, cp, changes, inner_changes, cont;
-    int num_unassigned, ret_val;
-
-   // Walk through all basic blocks in each function.
-    do {
-        changes = false;
+    std::vector<std::vector<size_t>>::iterator stage_it;
+    std::unordered_map<LLVMValueRef, int>::iterator count_it;
+    int num_unassigned;
+
+    unassigned.clear();
+    skipped_passes.clear();
+    exhausted = false;
+    fuel_used = 0;
+    dataflow_visits_start = am.get_dataflow_visits();
+    deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(time_budget_ms));
+
+    for (stage_it = pipeline.begin(); stage_it != pipeline.end(); ++stage_it) {
         for (f = LLVMGetFirstFunction(m); f != NULL; f = LLVMGetNextFunction(f)) {
-            // Perform local optimizations.
-            for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-                sec = common_sub_expr_elim(bb);
-                dce = dead_code_elim(bb);
-                if (sec || dce) changes = true;
-            }
+            // Declarations have no body to optimize.
+            if (LLVMGetFirstBasicBlock(f) == NULL) continue;
 
-            do {
-                inner_changes = false;
-                // Perform constant propagation.
-                cp = constant_propagation(f);
+            run_stage(f, *stage_it);
+        }
 
-                if (cp) inner_changes = true;
+        // Later stages assume a successful analysis.
+        for (count_it = unassigned.begin(); count_it != unassigned.end(); ++count_it)
+            if (count_it->second == -1) return -1;
+    }
 
-                // Perform constant folding.
-                for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-                    cf = constant_folding(bb);
-                    if (cf) inner_changes = true;
-                }
-            } while (inner_changes);
+    num_unassigned = 0;
+    for (count_it = unassigned.begin(); count_it != unassigned.end(); ++count_it) num_unassigned += count_it->second;
+
+    return num_unassigned;
+}
+
+/*
+ * Runs one pipeline stage on a function until reaching a fixed point or the iteration cap.
+ * Block passes and constant propagation are local: they only revisit blocks marked dirty, i.e. blocks holding users of a
+ * replaced value or operands of a removed instruction, and constant propagation only reruns after a stored value changed.
+ * The remaining passes run once the local passes settle, and mark every block dirty when they change anything.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ * - stage: registry indices of the passes to run, in order.
+ *
+ * Returns:
+ * - True if any pass changed the function, false otherwise
+ */
+bool Optimizer::run_stage(LLVMValueRef f, const std::vector<size_t>& stage) {
+    LLVMBasicBlockRef bb;
+    std::vector<size_t>::const_iterator pass_it;
+    bool changes, any_changes, store_change;
+    size_t iterations;
+
+    mark_function_dirty(f);
+    any_changes = false;
+    iterations = 0;
 
+    do {
+        changes = false;
+
+        // Settle the local passes on the dirty blocks.
+        while (!dirty_blocks.empty() || stores_dirty) {
+            store_change = stores_dirty;
+            stores_dirty = false;
+
+            for (pass_it = stage.begin(); pass_it != stage.end(); ++pass_it)
+                if (pass_enabled[*pass_it] && pass_registry[*pass_it].on_store_change && store_change && consume_budget(*pass_it, count_instructions(f)))
+                    if ((this->*pass_registry[*pass_it].function_pass)(f)) changes = true;
+
+            for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+                if (dirty_blocks.erase(bb) == 0) continue;
+
+                for (pass_it = stage.begin(); pass_it != stage.end(); ++pass_it)
+                    if (pass_enabled[*pass_it] && pass_registry[*pass_it].block_pass != NULL && consume_budget(*pass_it, count_instructions(bb)))
+                        if ((this->*pass_registry[*pass_it].block_pass)(bb)) changes = true;
+            }
         }
-    } while (changes);
 
-    // Perform live variable analysis.
-   cont = true;
-    num_unassigned = 0;
-    for (f = LLVMGetFirstFunction(m); f != NULL && cont; f = LLVMGetNextFunction(f)) {
-        if ((ret_val = live_variable_analysis(LLVMGetFirstFunction(m))) == -1) {
-            cont = false;
-            num_unassigned = ret_val;
-        } else num_unassigned += ret_val;
+        // Whole-function passes; any change restarts the local passes everywhere.
+        for (pass_it = stage.begin(); pass_it != stage.end(); ++pass_it) {
+            if (!pass_enabled[*pass_it] || pass_registry[*pass_it].function_pass == NULL || pass_registry[*pass_it].on_store_change) continue;
+            if (!consume_budget(*pass_it, count_instructions(f))) continue;
+
+            if ((this->*pass_registry[*pass_it].function_pass)(f)) {
+                changes = true;
+                mark_function_dirty(f);
+            }
+        }
+
+        // Iterating only pays off if something changed.
+        if (changes) any_changes = true;
+        iterations++;
+        stats["pipeline.iterations"]++;
+    } while (changes && (max_iterations == 0 || iterations < max_iterations));
+    if (changes) stats["pipeline.iteration_cap_reached"]++;
+
+    dirty_blocks.clear();
+    stores_dirty = false;
+
+    return any_changes;
+}
+
+/*
+ * Sets the pipeline from a description: pass names separated by commas, stages separated by semicolons.
+ * Spaces are ignored. A description with a single stage, like "cse,dce,sccp", iterates those passes to a fixed point.
+ *
+ * Args:
+ * - passes: pipeline description.
+ *
+ * Returns:
+ * - True on success, false if a pass name is unknown (the pipeline is left unchanged)
+ */
+bool Optimizer::set_pipeline(const std::string& passes) {
+    std::vector<std::vector<size_t>> stages;
+    std::vector<size_t> stage;
+    std::string name;
+    std::string::const_iterator c;
+    size_t k;
+
+    for (c = passes.begin(); ; ++c) {
+        if (c != passes.end() && *c != ',' && *c != ';') {
+            if (*c != ' ') name.push_back(*c);
+            continue;
+        }
+
+        // End of a pass name.
+        if (!name.empty()) {
+            for (k = 0; k < num_passes && name != pass_registry[k].name; k++);
+            if (k == num_passes) {
+                std::cerr << "Unknown pass '" << name << "'. Known passes:";
+                for (k = 0; k < num_passes; k++) std::cerr << " " << pass_registry[k].name;
+                std::cerr << "\n";
+                return false;
+            }
+            stage.push_back(k);
+            name.clear();
+        }
+
+        // End of a stage.
+        if (c == passes.end() || *c == ';') {
+            if (!stage.empty()) stages.push_back(stage);
+            stage.clear();
+        }
+
+        if (c == passes.end()) break;
     }
 
-    return num_unassigned;
+    pipeline = stages;
+    pass_enabled.assign(num_passes, true);
+
+    return true;
+}
+
+/*
+ * Selects a predefined pipeline: 0 runs no passes, 1 a cheap pipeline for fast builds, 2 the full pipeline.
+ *
+ * Returns:
+ * - True on success, false if the level is not 0, 1 or 2
+ */
+bool Optimizer::set_opt_level(int level) {
+    if (level < 0 || level > 2) {
+        std::cerr << "Invalid optimization level " << level << ".\n";
+        return false;
+    }
+
+    return set_pipeline(opt_level_pipelines[level]);
+}
+
+/*
+ * Enables or disables a pass by name. Disabled passes stay in the pipeline but are skipped.
+ * Enabling a pass the pipeline does not contain appends it as a final stage of its own.
+ *
+ * Returns:
+ * - True on success, false if the pass name is unknown
+ */
+bool Optimizer::set_pass_enabled(const std::string& name, bool enabled) {
+    std::vector<std::vector<size_t>>::iterator stage_it;
+    bool found;
+    size_t k;
+
+    for (k = 0; k < num_passes && name != pass_registry[k].name; k++);
+    if (k == num_passes) {
+        std::cerr << "Unknown pass '" << name << "'.\n";
+        return false;
+    }
+
+    pass_enabled[k] = enabled;
+
+    found = false;
+    for (stage_it = pipeline.begin(); stage_it != pipeline.end() && !found; ++stage_it)
+        if (std::find(stage_it->begin(), stage_it->end(), k) != stage_it->end()) found = true;
+    if (enabled && !found) pipeline.push_back({k});
+
+    return true;
+}
+
+/*
+ * Caps the number of fixed-point iterations of each stage on each function; 0 means no cap.
+ */
+void Optimizer::set_max_iterations(size_t n) { max_iterations = n; }
+
+/*
+ * Limits the wall-clock time of each call to optimize, in milliseconds; 0 means no limit.
+ */
+void Optimizer::set_time_budget(double ms) { time_budget_ms = ms; }
+
+/*
+ * Limits the work of each call to optimize to a number of instruction visits: every pass run is charged the instructions
+ * of the block or function it visits, and every dataflow block visit costs one more. 0 means no limit.
+ */
+void Optimizer::set_fuel(size_t fuel) { this->fuel = fuel; }
+
+/*
+ * Checks whether the last call to optimize ran out of time or fuel.
+ */
+bool Optimizer::budget_exhausted(void) const { return exhausted; }
+
+/*
+ * Getter method for the number of pass runs skipped per pass after the budget ran out.
+ */
+const std::map<std::string, size_t>& Optimizer::get_skipped_passes(void) const { return skipped_passes; }
+
+/*
+ * Charges a pass run against the budget.
+ * Dataflow solves are not interrupted, since a partial solution would be unsound, but their block visits are charged
+ * to the fuel before the next pass starts.
+ *
+ * Args:
+ * - pass: registry index of the pass about to run.
+ * - cost: instructions the pass will visit.
+ *
+ * Returns:
+ * - True if the pass may run, false if the budget is exhausted (the skip is recorded)
+ */
+bool Optimizer::consume_budget(size_t pass, size_t cost) {
+    if (!exhausted) {
+        if (time_budget_ms > 0 && std::chrono::steady_clock::now() >= deadline) exhausted = true;
+        if (fuel > 0 && fuel_used + am.get_dataflow_visits() - dataflow_visits_start + cost > fuel) exhausted = true;
+    }
+
+    if (exhausted) {
+        skipped_passes[pass_registry[pass].name]++;
+        return false;
+    }
+
+    fuel_used += cost;
+    return true;
 }
 
 /*
@@ -601,6 +1217,135 @@ int Optimizer::optimize(void) {
  */
 LLVMModuleRef Optimizer::get_module_ref(void) const { return m; }
 
+/*
+ * Getter method for the number of basic block visits made by the dataflow solvers.
+ */
+size_t Optimizer::get_dataflow_visits(void) const { return am.get_dataflow_visits(); }
+
+/*
+ * Getter method for the number of analysis requests answered from the cache.
+ */
+size_t Optimizer::get_analysis_reuses(void) const { return am.get_num_reused(); }
+
+/*
+ * Getter method for all statistics, keyed "<pass>.<what>", e.g. "gvn.eliminated".
+ */
+const std::map<std::string, size_t>& Optimizer::get_statistics(void) const { return stats; }
+
+/*
+ * Getter method for one statistic; 0 if it was never counted.
+ */
+size_t Optimizer::get_statistic(const std::string& name) const {
+    std::map<std::string, size_t>::const_iterator it;
+
+    it = stats.find(name);
+    return it == stats.end() ? 0 : it->second;
+}
+
+/*
+ * Turns recording of remarks on or off. Remarks print every transformed instruction, so they are off by default.
+ */
+void Optimizer::enable_remarks(bool enabled) { remarks_enabled = enabled; }
+
+/*
+ * Counts a transformation towards a statistic and, if remarks are enabled, records where it happened.
+ * Must be called before the instruction or block is changed.
+ *
+ * Args:
+ * - statistic: name of the statistic, "<pass>.<what>".
+ * - v: instruction or basic block (as a value) transformed, or NULL.
+ */
+void Optimizer::record(const std::string& statistic, LLVMValueRef v) {
+    Remark remark;
+    LLVMBasicBlockRef bb, it;
+    LLVMValueRef f;
+    size_t size, index;
+    char* str;
+
+    stats[statistic]++;
+    if (!remarks_enabled) return;
+
+    remark.statistic = statistic;
+    bb = NULL;
+    if (v != NULL && LLVMValueIsBasicBlock(v)) bb = LLVMValueAsBasicBlock(v);
+    else if (v != NULL && LLVMIsAInstruction(v)) {
+        bb = LLVMGetInstructionParent(v);
+        str = LLVMPrintValueToString(v);
+        remark.instruction = str;
+        LLVMDisposeMessage(str);
+        remark.instruction.erase(0, remark.instruction.find_first_not_of(' '));
+    }
+
+    if (bb != NULL) {
+        f = LLVMGetBasicBlockParent(bb);
+        remark.function = LLVMGetValueName2(f, &size);
+
+        // Blocks are usually unnamed, so they are identified by their position in the function.
+        index = 0;
+        for (it = LLVMGetFirstBasicBlock(f); it != NULL && it != bb; it = LLVMGetNextBasicBlock(it)) index++;
+        remark.block = std::format("bb{}", index);
+    }
+
+    remarks.push_back(remark);
+}
+
+/*
+ * Quotes a string for YAML, doubling embedded single quotes.
+ */
+static std::string yaml_quote(const std::string& str) {
+    std::string quoted;
+    std::string::const_iterator c;
+
+    quoted = "'";
+    for (c = str.begin(); c != str.end(); ++c) {
+        if (*c == '\'') quoted += "''";
+        else quoted.push_back(*c);
+    }
+    quoted += "'";
+
+    return quoted;
+}
+
+/*
+ * Writes the recorded remarks as a stream of YAML documents, one per transformation, followed by the statistics.
+ *
+ * Args:
+ * - fname: remarks file name.
+ *
+ * Returns:
+ * - True on success, false if the file could not be written
+ */
+bool Optimizer::write_remarks(const std::string& fname) const {
+    FILE* fp;
+    std::vector<Remark>::const_iterator it;
+    std::map<std::string, size_t>::const_iterator stat_it;
+    std::string pass;
+
+    if ((fp = fopen(fname.c_str(), "w")) == NULL) {
+        std::cerr << "Failed to open remarks file.\n";
+        return false;
+    }
+
+    for (it = remarks.begin(); it != remarks.end(); ++it) {
+        pass = it->statistic.substr(0, it->statistic.find('.'));
+        fprintf(fp, "--- !Passed\n");
+        fprintf(fp, "Pass: %s\n", pass.c_str());
+        fprintf(fp, "Name: %s\n", it->statistic.substr(pass.size() + 1).c_str());
+        fprintf(fp, "Function: %s\n", yaml_quote(it->function).c_str());
+        fprintf(fp, "Block: %s\n", it->block.c_str());
+        if (!it->instruction.empty()) fprintf(fp, "Instruction: %s\n", yaml_quote(it->instruction).c_str());
+        fprintf(fp, "...\n");
+    }
+
+    fprintf(fp, "--- !Statistics\n");
+    for (stat_it = stats.begin(); stat_it != stats.end(); ++stat_it) fprintf(fp, "%s: %zu\n", stat_it->first.c_str(), stat_it->second);
+    fprintf(fp, "...\n");
+
+    fclose(fp);
+
+    return true;
+}
+
 /*
  * Prints out LLVM Module to stdout.
  */
@@ -612,20 +1357,61 @@ void Optimizer::print_module(void) const {
 /*
  * Prints out all instructions in each basic block of all sets.
  */
-void Optimizer::print_set(std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>& print_set) {
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>::iterator map_it;
-    std::set<LLVMValueRef>::iterator set_it;
+void Optimizer::print_set(std::vector<BitVector>& print_set, std::vector<LLVMValueRef>& instrs) {
+    size_t b, k;
 
-    for (map_it = print_set.begin(); map_it != print_set.end(); ++map_it) {
-        std::cout << "Block " << map_it->first << ":\n";
-        for (set_it = map_it->second.begin(); set_it != map_it->second.end(); ++set_it) {
-            LLVMDumpValue(*set_it);
+    for (b = 0; b < print_set.size(); b++) {
+        std::cout << "Block " << b << ":\n";
+        for (k = print_set[b].find_first(); k < print_set[b].size(); k = print_set[b].find_next(k + 1)) {
+            LLVMDumpValue(instrs[k]);
             std::cout << std::endl;
         }
     }
     std::cout << std::endl;
 }
 
+/*
+ * Marks the blocks of all users of a value for revisiting, before the value is replaced or removed.
+ * A store among the users changes what the reaching stores say, so constant propagation must also rerun.
+ */
+void Optimizer::mark_users_dirty(LLVMValueRef v) {
+    LLVMUseRef use;
+    LLVMValueRef user;
+
+    for (use = LLVMGetFirstUse(v); use != NULL; use = LLVMGetNextUse(use)) {
+        user = LLVMGetUser(use);
+        if (!LLVMIsAInstruction(user)) continue;
+
+        dirty_blocks.insert(LLVMGetInstructionParent(user));
+        if (LLVMGetInstructionOpcode(user) == LLVMStore) stores_dirty = true;
+    }
+}
+
+/*
+ * Marks the blocks defining the operands of an instruction for revisiting, before the instruction is removed.
+ */
+void Optimizer::mark_operands_dirty(LLVMValueRef i) {
+    LLVMValueRef operand;
+    int k;
+
+    for (k = 0; k < LLVMGetNumOperands(i); k++) {
+        operand = LLVMGetOperand(i, k);
+        if (LLVMIsAInstruction(operand)) dirty_blocks.insert(LLVMGetInstructionParent(operand));
+    }
+}
+
+/*
+ * Marks every block of a function for revisiting, after a pass that may have changed any of them.
+ * Blocks deleted by earlier passes are dropped from the set, so it never holds dangling references for long.
+ */
+void Optimizer::mark_function_dirty(LLVMValueRef f) {
+    LLVMBasicBlockRef bb;
+
+    dirty_blocks.clear();
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) dirty_blocks.insert(bb);
+    stores_dirty = true;
+}
+
 /*
  * Performs constant propagation.
  * Replaces uses of constant load instructions with a constant.
@@ -639,14 +1425,14 @@ void Optimizer::print_set(std::unordered_map<LLVMBasicBlockRef, std::set<LLVMVal
  */
 bool Optimizer::constant_propagation(LLVMValueRef f) {
     LLVMValueRef i, operand;
-    LLVMBasicBlockRef bb;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> r, gen_fa, kill_fa, in_fa, out_fa;
-    std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>> opt_map;
-    std::optional<std::pair<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>>> opt_pair;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>::iterator map_it;
+    const MemoryDataflow* reaching;
+    BitVector r;
+    std::vector<size_t> stores, killed;
+    std::vector<size_t>::iterator vec_it;
     std::set<LLVMValueRef>::iterator set_it;
     bool changes, same_val;
-    std::set<LLVMValueRef> deletions, stores, killed;
+    std::set<LLVMValueRef> deletions;
+    size_t b;
     int val, j;
 
     if (f == NULL) {
@@ -654,54 +1440,44 @@ bool Optimizer::constant_propagation(LLVMValueRef f) {
         return false;
     }
 
-    // Compute relevant sets.
-    opt_map = compute_gen_fa(f);
-    if (!opt_map.has_value()) return false;
-    else gen_fa = opt_map.value();
-    opt_map = compute_kill_fa(f);
-    if (!opt_map.has_value()) return false;
-    else kill_fa = opt_map.value();
-    opt_pair = compute_in_and_out_fa(f, gen_fa, kill_fa);
-    if (!opt_pair.has_value()) return false;
-    else {
-        in_fa = opt_pair.value().first;
-        out_fa = opt_pair.value().second;
-    }
-
-    // Initialize R[B] = IN[B].
-    for (map_it = in_fa.begin(); map_it != in_fa.end(); ++map_it)
-        r.insert({map_it->first, map_it->second});
+    // Get stores reaching each basic block.
+    if ((reaching = am.get_reaching_stores(f)) == NULL) return false;
 
     changes = false;
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+    for (b = 0; b < reaching->num.blocks.size(); b++) {
+        // Initialize R[B] = IN[B].
+        r = reaching->in[b];
+
+        for (i = LLVMGetFirstInstruction(reaching->num.blocks[b]); i != NULL; i = LLVMGetNextInstruction(i)) {
             if (LLVMGetInstructionOpcode(i) == LLVMStore) {
                 // Check to see which instructions are killed by i.
-                killed = find_instrs_with_operand(r[bb], LLVMGetOperand(i, 0));
+                killed = find_instrs_with_operand(r, reaching->num, LLVMGetOperand(i, 1));
 
                 // Remove all instructions from R.
-                for (set_it = killed.begin(); set_it != killed.end(); ++set_it) r[bb].erase(*set_it);
+                for (vec_it = killed.begin(); vec_it != killed.end(); ++vec_it) r.reset(*vec_it);
 
                 // Add store instruction to R.
-                r[bb].insert(i);
+                r.set(reaching->num.instr_num.at(i));
             } else if (LLVMGetInstructionOpcode(i) == LLVMLoad) {
                 // Find all stores that store to location of load instruction.
-                stores = find_instrs_with_operand(r[bb], LLVMGetOperand(i, 0));
+                stores = find_instrs_with_operand(r, reaching->num, LLVMGetOperand(i, 0));
 
                 // Check is all stores are to the same value.
                 same_val = true;
                 j = 0;
-                for (set_it = stores.begin(); set_it != stores.end() && same_val; ++set_it) {
-                    operand = LLVMGetOperand(*set_it, 0);
+                for (vec_it = stores.begin(); vec_it != stores.end() && same_val; ++vec_it) {
+                    operand = LLVMGetOperand(reaching->num.instrs[*vec_it], 0);
                     if (LLVMIsConstant(operand) && LLVMGetTypeKind(LLVMTypeOf(operand)) == LLVMIntegerTypeKind) {
-                        if (j == 0) val = LLVMConstIntGetSExtValue(LLVMGetOperand(*set_it, 0));
-                        else if (val != LLVMConstIntGetSExtValue(LLVMGetOperand(*set_it, 0))) same_val = false;
+                        if (j == 0) val = LLVMConstIntGetSExtValue(operand);
+                        else if (val != LLVMConstIntGetSExtValue(operand)) same_val = false;
                         j++;
                     } else same_val = false;
                 }
 
                 // Replace all uses of load with constant value and mark load for deletion.
                 if (same_val && !stores.empty()) {
+                    record("constprop.loads_replaced", i);
+                    mark_users_dirty(i);
                     LLVMReplaceAllUsesWith(i, LLVMConstInt(LLVMInt32Type() , val, true));
                     deletions.insert(i);
                     changes = true;
@@ -714,6 +1490,9 @@ bool Optimizer::constant_propagation(LLVMValueRef f) {
     for (set_it = deletions.begin(); set_it != deletions.end(); ++set_it)
         LLVMInstructionEraseFromParent(*set_it);
 
+    // Only loads were removed.
+    if (changes) am.invalidate(f, PRESERVE_CFG | PRESERVE_REACHING_STORES);
+
     return changes;
 }
 
@@ -729,64 +1508,52 @@ bool Optimizer::constant_propagation(LLVMValueRef f) {
  * - -1 on failure, number of loads in IN of first basic block (unassigned variables) on success
  */
 int Optimizer::live_variable_analysis(LLVMValueRef f) {
-    LLVMValueRef i;
-    LLVMBasicBlockRef bb;
-    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>> gen_ra, kill_ra, in_ra, out_ra;
-    std::optional<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>> opt_map;
-    std::optional<std::pair<std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>, std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>>> opt_pair;
-    std::set<LLVMValueRef>::iterator set_it;
-    std::set<LLVMValueRef> deletions, loads, r;
+    const MemoryDataflow* live;
+    int num_unassigned;
 
     if (f == NULL) {
         std::cerr << "Invalid argument to function.\n";
         return -1;
     }
 
-    // Compute relevant sets.
-    opt_map = compute_gen_ra(f);
-    if (!opt_map.has_value()) return false;
-    else gen_ra = opt_map.value();
-    opt_map = compute_kill_ra(f);
-    if (!opt_map.has_value()) return false;
-    else kill_ra = opt_map.value();
-    opt_pair = compute_in_and_out_ra(f, gen_ra, kill_ra);
-    if (!opt_pair.has_value()) return false;
-    else {
-        in_ra = opt_pair.value().first;
-        out_ra = opt_pair.value().second;
-    }
+    // Declarations have no body to analyze.
+    if (LLVMGetFirstBasicBlock(f) == NULL) return 0;
 
-    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        // Add OUT[B] to R.
-        r = out_ra[bb];
+    // Get loads live at each basic block.
+    if ((live = am.get_live_loads(f)) == NULL) return -1;
 
-        // Begin at last instruction in the basic block and work backwards.
-        for (i = LLVMGetLastInstruction(bb); i != NULL; i = LLVMGetPreviousInstruction(i)) {
-            if (LLVMGetInstructionOpcode(i) == LLVMLoad)
-                // Add load instruction to R.
-                r.insert(i);
-            else if (LLVMGetInstructionOpcode(i) == LLVMStore) {
-                // Check if any load instructions rely on this store instruction.
-                loads = find_instrs_with_operand(r, LLVMGetOperand(i, 1));
+    // Loads live on entry read a variable before any store; read before dead stores are deleted.
+    num_unassigned = live->in[0].count();
 
-                // Remove load instructions from R since their correspinding store ahs been found.
-                if (!loads.empty()) for (set_it = loads.begin(); set_it != loads.end(); ++set_it) r.erase(*set_it);
-                    // Mark store instruction for deletion if no load instructions depend on it.
-                else deletions.insert(i);
-            }
-        }
-    }
+    dead_store_elimination(f);
 
-    // Delete all marked load instructions.
-    for (set_it = deletions.begin(); set_it != deletions.end(); ++set_it)
-        LLVMInstructionEraseFromParent(*set_it);
+    return num_unassigned;
+}
+
+/*
+ * Pipeline entry for live variable analysis: records the number of unassigned variables of the function.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any dead store was removed, false otherwise
+ */
+bool Optimizer::run_live_variable_analysis(LLVMValueRef f) {
+    size_t removed;
 
-    return in_ra[LLVMGetFirstBasicBlock(f)].size();
+    removed = get_statistic("dse.stores_removed") + get_statistic("dse.allocas_removed");
+    unassigned[f] = live_variable_analysis(f);
+    if (unassigned[f] > 0) stats["lva.unassigned"] += unassigned[f];
+
+    return get_statistic("dse.stores_removed") + get_statistic("dse.allocas_removed") != removed;
 }
 
 /*
- * Performs common subexpression elimination.
- * If two instructions have the same opcode and operands with unmodified operands, make the later instruction point to the earlier one.
+ * Performs common subexpression elimination by local value numbering.
+ * Walks the basic block once, keeping a hash table from (opcode, predicate, operands) to the first instruction computing it.
+ * A later instruction with the same key has its uses pointed to the earlier one.
+ * A store removes the table entry for loads from the stored location.
  *
  * Args:
  * - bb (LLVMBasicBlockRef): pointer to current basic block
@@ -795,10 +1562,11 @@ int Optimizer::live_variable_analysis(LLVMValueRef f) {
  * - bool: true if any changes, false otherwise
  */
 bool Optimizer::common_sub_expr_elim(LLVMBasicBlockRef bb) {
-    LLVMValueRef i, j;
-    LLVMOpcode op_i, op_j;
-    bool changes, store_found, same;
-    int k;
+    LLVMValueRef i;
+    std::unordered_map<ExprKey, LLVMValueRef, ExprKeyHash> table;
+    std::unordered_map<ExprKey, LLVMValueRef, ExprKeyHash>::iterator table_it;
+    ExprKey key;
+    bool changes;
 
     // Ensure block exists.
     if (bb == NULL) {
@@ -809,39 +1577,36 @@ bool Optimizer::common_sub_expr_elim(LLVMBasicBlockRef bb) {
     changes = false;
 
     for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
-        // Do not eliminate all kinds of instructions.
-        if (LLVMGetInstructionOpcode(i) != LLVMCall && LLVMGetInstructionOpcode(i) != LLVMStore && !LLVMIsATerminatorInst(i) && LLVMGetInstructionOpcode(i) != LLVMAlloca) {
-            store_found = false;
-            for (j = LLVMGetNextInstruction(i); j != NULL && !store_found; j = LLVMGetNextInstruction(j)) {
-                op_i = LLVMGetInstructionOpcode(i);
-                op_j = LLVMGetInstructionOpcode(j);
-
-                // There may be no store instruction to the same location as a load instruction.
-                if (op_i == LLVMLoad && op_j == LLVMStore && LLVMGetOperand(i, 0) == LLVMGetOperand(j, 1)) store_found = true;
-                else if (op_i == op_j && LLVMGetFirstUse(j) != NULL) {
-                    // All operands should be the same.
-                    same = true;
-                    for (k = 0; k < LLVMGetNumOperands(i); k++)
-                        if (LLVMGetOperand(i, k) != LLVMGetOperand(j, k))
-                            same = false;
-
-                    if (same) {
-                        // Replace uses of j with i.
-                        LLVMReplaceAllUsesWith(j, i);
-                        changes = true;
-                    }
-                }
+        if (LLVMGetInstructionOpcode(i) == LLVMStore) {
+            // Loads from the stored location no longer produce the same value.
+            key.op = LLVMLoad;
+            key.pred = 0;
+            key.operands = {LLVMGetOperand(i, 1)};
+            table.erase(key);
+        } else if (is_value_numbered(i)) {
+            key = make_expr_key(i);
+
+            if ((table_it = table.find(key)) == table.end()) table.insert({key, i});
+            else if (LLVMGetFirstUse(i) != NULL) {
+                // Replace uses of i with the earlier instruction.
+                record("cse.replaced", i);
+                mark_users_dirty(i);
+                LLVMReplaceAllUsesWith(i, table_it->second);
+                changes = true;
             }
         }
     }
 
+    // Uses are redirected but no instruction is removed.
+    if (changes) am.invalidate(LLVMGetBasicBlockParent(bb), PRESERVE_ALL);
+
     return changes;
 }
 
 /*
  * Performs dead code elimination.
  * If an instruction is not used, delete that instruction.
- * Does not delete store or return instructions due to possibel side effects or indirect uses.
+ * Does not delete store, call or return instructions due to possibel side effects or indirect uses.
  *
  * Args:
  * - bb (LLVMBasicBlockRef): pointer to current basic block
@@ -863,9 +1628,11 @@ bool Optimizer::dead_code_elim(LLVMBasicBlockRef bb) {
     prev = NULL;
 
     for (i = LLVMGetFirstInstruction(bb); i != NULL; i = next) {
-        // Instruction is deleted if not used, not a store, alloc or not a terminator.
-        if (LLVMGetFirstUse(i) == NULL && LLVMGetInstructionOpcode(i) != LLVMStore && LLVMGetInstructionOpcode(i) != LLVMAlloca && !LLVMIsATerminatorInst(i)) {
-            // Remove instruction.
+        // Instruction is deleted if not used, not a store, alloc, call or not a terminator.
+        if (LLVMGetFirstUse(i) == NULL && LLVMGetInstructionOpcode(i) != LLVMStore && LLVMGetInstructionOpcode(i) != LLVMAlloca && LLVMGetInstructionOpcode(i) != LLVMCall && !LLVMIsATerminatorInst(i)) {
+            // Remove instruction; its operands may now be unused.
+            record("dce.removed", i);
+            mark_operands_dirty(i);
             LLVMInstructionEraseFromParent(i);
 
             // Revert to prevoius instruction.
@@ -882,6 +1649,9 @@ bool Optimizer::dead_code_elim(LLVMBasicBlockRef bb) {
         }
     }
 
+    // Unused loads may have been removed, but never stores.
+    if (changes) am.invalidate(LLVMGetBasicBlockParent(bb), PRESERVE_CFG | PRESERVE_REACHING_STORES);
+
     return changes;
 }
 
@@ -936,6 +1706,8 @@ bool Optimizer::constant_folding(LLVMBasicBlockRef bb) {
                         std::cerr << "Unrecognized operand.\n";
                 }
                 // Replace uses of constant add instructions.
+                record("constfold.folded", i);
+                mark_users_dirty(i);
                 LLVMReplaceAllUsesWith(i, cnst);
 
                 // Mark instruction to be deleted.
@@ -950,5 +1722,1426 @@ bool Optimizer::constant_folding(LLVMBasicBlockRef bb) {
     for (set_it = deletions.begin(); set_it != deletions.end(); ++set_it)
         LLVMInstructionEraseFromParent(*set_it);
 
+    // Only arithmetic instructions were removed.
+    if (changes) am.invalidate(LLVMGetBasicBlockParent(bb), PRESERVE_ALL);
+
     return changes;
 }
+
+/*
+ * Performs memory to register promotion.
+ * Allocas that are only ever loaded from and stored to are replaced by SSA values.
+ * Phi instructions are placed on the iterated dominance frontier of each alloca's stores and loads/stores are renamed
+ * by walking the dominator tree.
+ * Variables read before being written take the value zero, and narrower integers stored to a slot are zero-extended.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any allocas were promoted, false otherwise
+ */
+bool Optimizer::mem_to_reg(LLVMValueRef f) {
+    LLVMValueRef i, user, phi, val;
+    LLVMBasicBlockRef bb, succ;
+    LLVMBuilderRef b;
+    LLVMUseRef use;
+    std::vector<LLVMValueRef> allocas, deletions, phis;
+    std::vector<LLVMValueRef>::iterator val_it;
+    std::unordered_map<LLVMValueRef, size_t> alloca_idx;
+    std::vector<LLVMBasicBlockRef> rpo, work, succs;
+    std::vector<LLVMBasicBlockRef>::iterator succ_it;
+    std::vector<LLVMBasicBlockRef>::const_iterator child_it;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> preds;
+    std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>> df;
+    const DomTree* dt;
+    std::set<LLVMBasicBlockRef>::iterator df_it;
+    std::set<LLVMBasicBlockRef> has_phi, def_blocks;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<std::pair<LLVMValueRef, size_t>>> block_phis;
+    std::vector<std::pair<LLVMValueRef, size_t>>::iterator phi_it;
+    std::vector<std::vector<LLVMValueRef>> stacks;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<size_t>> pushed;
+    std::vector<std::pair<LLVMBasicBlockRef, bool>> dom_stack;
+    std::vector<size_t>::iterator idx_it;
+    std::unordered_set<LLVMValueRef> live_phis;
+    LLVMOpcode op;
+    bool promotable, change, exiting;
+    size_t k;
+    unsigned int num;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    // Find promotable allocas: integer slots whose only uses are loads of the slot's type from them and stores to them
+    // of integers no wider than the slot, such as comparison results stored to an int.
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (LLVMGetInstructionOpcode(i) != LLVMAlloca || LLVMGetTypeKind(LLVMGetAllocatedType(i)) != LLVMIntegerTypeKind) continue;
+
+            promotable = true;
+            for (use = LLVMGetFirstUse(i); use != NULL && promotable; use = LLVMGetNextUse(use)) {
+                user = LLVMGetUser(use);
+                op = LLVMGetInstructionOpcode(user);
+                if (op == LLVMLoad) promotable = LLVMTypeOf(user) == LLVMGetAllocatedType(i);
+                else if (op != LLVMStore || LLVMGetOperand(user, 1) != i || LLVMGetOperand(user, 0) == i) promotable = false;
+                else promotable = LLVMGetTypeKind(LLVMTypeOf(LLVMGetOperand(user, 0))) == LLVMIntegerTypeKind
+                    && LLVMGetIntTypeWidth(LLVMTypeOf(LLVMGetOperand(user, 0))) <= LLVMGetIntTypeWidth(LLVMGetAllocatedType(i));
+            }
+
+            if (promotable) {
+                alloca_idx[i] = allocas.size();
+                allocas.push_back(i);
+            }
+        }
+    }
+
+    if (allocas.empty()) return false;
+
+    // Build CFG information.
+    preds = am.get_preds(f);
+    rpo = am.get_rpo(f);
+    df = am.get_dominance_frontiers(f);
+    dt = &am.get_dom_tree(f);
+
+    b = LLVMCreateBuilder();
+
+    // Place phi instructions on the iterated dominance frontier of the blocks storing to each alloca.
+    for (k = 0; k < allocas.size(); k++) {
+        def_blocks.clear();
+        has_phi.clear();
+        for (use = LLVMGetFirstUse(allocas[k]); use != NULL; use = LLVMGetNextUse(use)) {
+            user = LLVMGetUser(use);
+            if (LLVMGetInstructionOpcode(user) == LLVMStore && dt->contains(LLVMGetInstructionParent(user)))
+                def_blocks.insert(LLVMGetInstructionParent(user));
+        }
+
+        work.assign(def_blocks.begin(), def_blocks.end());
+        while (!work.empty()) {
+            bb = work.back();
+            work.pop_back();
+            for (df_it = df[bb].begin(); df_it != df[bb].end(); ++df_it) {
+                if (has_phi.contains(*df_it)) continue;
+
+                // Insert phi at start of frontier block.
+                LLVMPositionBuilderBefore(b, LLVMGetFirstInstruction(*df_it));
+                phi = LLVMBuildPhi(b, LLVMGetAllocatedType(allocas[k]), "");
+                block_phis[*df_it].push_back({phi, k});
+                phis.push_back(phi);
+                has_phi.insert(*df_it);
+
+                // A phi is a new definition of the variable.
+                if (!def_blocks.contains(*df_it)) {
+                    def_blocks.insert(*df_it);
+                    work.push_back(*df_it);
+                }
+            }
+        }
+    }
+
+    // Rename loads and stores by walking the dominator tree; each variable starts out as zero.
+    for (k = 0; k < allocas.size(); k++) stacks.push_back(std::vector<LLVMValueRef>(1, LLVMConstNull(LLVMGetAllocatedType(allocas[k]))));
+    dom_stack.push_back({rpo[0], false});
+    while (!dom_stack.empty()) {
+        bb = dom_stack.back().first;
+        exiting = dom_stack.back().second;
+        dom_stack.pop_back();
+
+        // Leaving block: restore the definitions that reached it.
+        if (exiting) {
+            for (idx_it = pushed[bb].begin(); idx_it != pushed[bb].end(); ++idx_it) stacks[*idx_it].pop_back();
+            continue;
+        }
+
+        // Phis placed in this block define their variables.
+        for (phi_it = block_phis[bb].begin(); phi_it != block_phis[bb].end(); ++phi_it) {
+            stacks[phi_it->second].push_back(phi_it->first);
+            pushed[bb].push_back(phi_it->second);
+        }
+
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            op = LLVMGetInstructionOpcode(i);
+            if (op == LLVMLoad && alloca_idx.contains(LLVMGetOperand(i, 0))) {
+                // Load takes the current definition of the variable.
+                LLVMReplaceAllUsesWith(i, stacks[alloca_idx[LLVMGetOperand(i, 0)]].back());
+                deletions.push_back(i);
+            } else if (op == LLVMStore && alloca_idx.contains(LLVMGetOperand(i, 1))) {
+                // Store becomes the new current definition of the variable.
+                k = alloca_idx[LLVMGetOperand(i, 1)];
+                val = LLVMGetOperand(i, 0);
+                if (LLVMTypeOf(val) != LLVMGetAllocatedType(allocas[k])) {
+                    LLVMPositionBuilderBefore(b, i);
+                    val = LLVMBuildZExt(b, val, LLVMGetAllocatedType(allocas[k]), "");
+                }
+                stacks[k].push_back(val);
+                pushed[bb].push_back(k);
+                deletions.push_back(i);
+            }
+        }
+
+        // Fill in this block's incoming values for phis in its successors.
+        succs = get_successors(bb);
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it) {
+            for (phi_it = block_phis[*succ_it].begin(); phi_it != block_phis[*succ_it].end(); ++phi_it) {
+                val = stacks[phi_it->second].back();
+                LLVMAddIncoming(phi_it->first, &val, &bb, 1);
+            }
+        }
+
+        // Visit dominator tree children before leaving block.
+        dom_stack.push_back({bb, true});
+        for (child_it = dt->get_children(bb).begin(); child_it != dt->get_children(bb).end(); ++child_it) dom_stack.push_back({*child_it, false});
+    }
+
+    LLVMDisposeBuilder(b);
+
+    // Unreachable blocks: loads read zero, stores vanish and successor phis receive zero.
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        if (dt->contains(bb)) continue;
+
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            op = LLVMGetInstructionOpcode(i);
+            if (op == LLVMLoad && alloca_idx.contains(LLVMGetOperand(i, 0))) {
+                LLVMReplaceAllUsesWith(i, LLVMConstNull(LLVMTypeOf(i)));
+                deletions.push_back(i);
+            } else if (op == LLVMStore && alloca_idx.contains(LLVMGetOperand(i, 1)))
+                deletions.push_back(i);
+        }
+
+        succs = get_successors(bb);
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it) {
+            succ = *succ_it;
+            for (phi_it = block_phis[succ].begin(); phi_it != block_phis[succ].end(); ++phi_it) {
+                val = LLVMConstNull(LLVMTypeOf(phi_it->first));
+                LLVMAddIncoming(phi_it->first, &val, &bb, 1);
+            }
+        }
+    }
+
+    // Delete renamed loads and stores, then the allocas themselves.
+    for (val_it = deletions.begin(); val_it != deletions.end(); ++val_it) LLVMInstructionEraseFromParent(*val_it);
+    for (val_it = allocas.begin(); val_it != allocas.end(); ++val_it) {
+        record("mem2reg.promoted", *val_it);
+        LLVMInstructionEraseFromParent(*val_it);
+    }
+
+    // Replace phis whose incoming values are all the same (apart from the phi itself) with that value.
+    do {
+        change = false;
+        for (val_it = phis.begin(); val_it != phis.end(); ++val_it) {
+            if (*val_it == NULL) continue;
+
+            val = NULL;
+            promotable = true;
+            for (num = 0; num < LLVMCountIncoming(*val_it) && promotable; num++) {
+                if (LLVMGetIncomingValue(*val_it, num) == *val_it) continue;
+                if (val == NULL) val = LLVMGetIncomingValue(*val_it, num);
+                else if (val != LLVMGetIncomingValue(*val_it, num)) promotable = false;
+            }
+
+            if (promotable && val != NULL) {
+                LLVMReplaceAllUsesWith(*val_it, val);
+                LLVMInstructionEraseFromParent(*val_it);
+                *val_it = NULL;
+                change = true;
+            }
+        }
+    } while (change);
+
+    // Remove phis that only feed other phis: mark phis used by real instructions, then propagate to their operands.
+    work.clear();
+    for (val_it = phis.begin(); val_it != phis.end(); ++val_it) {
+        if (*val_it == NULL) continue;
+        for (use = LLVMGetFirstUse(*val_it); use != NULL; use = LLVMGetNextUse(use)) {
+            if (LLVMGetInstructionOpcode(LLVMGetUser(use)) != LLVMPHI) {
+                live_phis.insert(*val_it);
+                break;
+            }
+        }
+    }
+    deletions.assign(live_phis.begin(), live_phis.end());
+    while (!deletions.empty()) {
+        phi = deletions.back();
+        deletions.pop_back();
+        for (num = 0; num < LLVMCountIncoming(phi); num++) {
+            val = LLVMGetIncomingValue(phi, num);
+            if (LLVMIsAPHINode(val) && !live_phis.contains(val)) {
+                live_phis.insert(val);
+                deletions.push_back(val);
+            }
+        }
+    }
+    for (val_it = phis.begin(); val_it != phis.end(); ++val_it)
+        if (*val_it != NULL && !live_phis.contains(*val_it)) LLVMReplaceAllUsesWith(*val_it, LLVMConstNull(LLVMTypeOf(*val_it)));
+    for (val_it = phis.begin(); val_it != phis.end(); ++val_it)
+        if (*val_it != NULL && !live_phis.contains(*val_it)) LLVMInstructionEraseFromParent(*val_it);
+
+    // Phis were added and loads, stores and allocas removed; blocks and edges are unchanged.
+    am.invalidate(f, PRESERVE_CFG);
+
+    return true;
+}
+
+/*
+ * Performs global value numbering over the dominator tree.
+ * Walks the dominator tree keeping a scoped hash table from (opcode, predicate, operands) to the instruction computing it;
+ * entries made in a block are visible in the blocks it dominates and removed when the walk leaves it.
+ * Arithmetic and comparisons recomputed in a dominated block are replaced by the dominating instruction and deleted.
+ * Loads are left to local value numbering since a store on any path between two blocks may change memory.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any instructions were eliminated, false otherwise
+ */
+bool Optimizer::global_value_numbering(LLVMValueRef f) {
+    LLVMValueRef i, next;
+    LLVMBasicBlockRef bb;
+    const DomTree* dt;
+    std::unordered_map<ExprKey, LLVMValueRef, ExprKeyHash> table;
+    std::unordered_map<ExprKey, LLVMValueRef, ExprKeyHash>::iterator table_it;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<ExprKey>> pushed;
+    std::vector<ExprKey>::iterator key_it;
+    std::vector<std::pair<LLVMBasicBlockRef, bool>> dom_stack;
+    std::vector<LLVMBasicBlockRef>::const_iterator child_it;
+    ExprKey key;
+    bool changes, exiting;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    dt = &am.get_dom_tree(f);
+    changes = false;
+
+    dom_stack.push_back({dt->get_root(), false});
+    while (!dom_stack.empty()) {
+        bb = dom_stack.back().first;
+        exiting = dom_stack.back().second;
+        dom_stack.pop_back();
+
+        // Leaving block: its expressions are not available in siblings.
+        if (exiting) {
+            for (key_it = pushed[bb].begin(); key_it != pushed[bb].end(); ++key_it) table.erase(*key_it);
+            continue;
+        }
+
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = next) {
+            next = LLVMGetNextInstruction(i);
+            if (!is_value_numbered(i) || LLVMGetInstructionOpcode(i) == LLVMLoad) continue;
+
+            key = make_expr_key(i);
+            if ((table_it = table.find(key)) == table.end()) {
+                table.insert({key, i});
+                pushed[bb].push_back(key);
+            } else {
+                // Dominating instruction computes the same value.
+                record("gvn.eliminated", i);
+                LLVMReplaceAllUsesWith(i, table_it->second);
+                LLVMInstructionEraseFromParent(i);
+                changes = true;
+            }
+        }
+
+        // Visit dominator tree children before leaving block.
+        dom_stack.push_back({bb, true});
+        for (child_it = dt->get_children(bb).begin(); child_it != dt->get_children(bb).end(); ++child_it) dom_stack.push_back({*child_it, false});
+    }
+
+    // Only arithmetic and comparisons were removed.
+    if (changes) am.invalidate(f, PRESERVE_ALL);
+
+    return changes;
+}
+
+/*
+ * Performs loop-invariant code motion.
+ * Every natural loop is given a preheader, then instructions whose operands are all defined outside the loop are moved
+ * to the end of the preheader, innermost loops first. Hoisting one instruction can make its users invariant, so each
+ * loop is scanned until nothing more moves.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any blocks were inserted or instructions hoisted, false otherwise
+ */
+bool Optimizer::loop_invariant_code_motion(LLVMValueRef f) {
+    LLVMValueRef i, next, operand;
+    LLVMBuilderRef b;
+    const std::vector<Loop>* loops;
+    std::vector<Loop>::const_iterator loop_it;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::unordered_set<LLVMValueRef> stored;
+    bool changes, cfg_changed, hoisted, invariant;
+    int k;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    // Give every loop a dedicated preheader.
+    cfg_changed = false;
+    loops = &am.get_loops(f);
+    for (loop_it = loops->begin(); loop_it != loops->end(); ++loop_it) {
+        if (loop_it->preheader != NULL) continue;
+        insert_preheader(*loop_it, am.get_preds(f));
+        cfg_changed = true;
+    }
+
+    if (cfg_changed) {
+        am.invalidate(f, PRESERVE_NONE);
+        loops = &am.get_loops(f);
+    }
+
+    b = LLVMCreateBuilder();
+    changes = false;
+
+    for (loop_it = loops->begin(); loop_it != loops->end(); ++loop_it) {
+        if (loop_it->preheader == NULL) continue;
+
+        // Allocas written inside the loop.
+        stored.clear();
+        for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end(); ++bb_it)
+            for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = LLVMGetNextInstruction(i))
+                if (LLVMGetInstructionOpcode(i) == LLVMStore) stored.insert(LLVMGetOperand(i, 1));
+
+        do {
+            hoisted = false;
+            for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end(); ++bb_it) {
+                for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = next) {
+                    next = LLVMGetNextInstruction(i);
+                    if (!is_hoistable(i, stored)) continue;
+
+                    // All operands must be defined outside the loop.
+                    invariant = true;
+                    for (k = 0; k < LLVMGetNumOperands(i) && invariant; k++) {
+                        operand = LLVMGetOperand(i, k);
+                        if (LLVMIsAInstruction(operand) && loop_it->block_set.contains(LLVMGetInstructionParent(operand))) invariant = false;
+                    }
+                    if (!invariant) continue;
+
+                    // Move to the end of the preheader.
+                    record("licm.hoisted", i);
+                    LLVMInstructionRemoveFromParent(i);
+                    LLVMPositionBuilderBefore(b, LLVMGetBasicBlockTerminator(loop_it->preheader));
+                    LLVMInsertIntoBuilder(b, i);
+                    hoisted = true;
+                    changes = true;
+                }
+            }
+        } while (hoisted);
+    }
+
+    LLVMDisposeBuilder(b);
+
+    // Loads may have moved between blocks; stores stayed put.
+    if (changes) am.invalidate(f, PRESERVE_CFG | PRESERVE_REACHING_STORES);
+
+    return changes || cfg_changed;
+}
+
+/*
+ * Performs strength reduction of induction variable multiplications, followed by linear-function test replacement.
+ * For a basic induction variable i = {init, +, step} and a loop-invariant factor c, a new variable t = {init * c, +, step * c}
+ * is created in the header and advanced next to i's update; i * c becomes t and (i + step) * c becomes t's update.
+ * When the exit test compares i to a constant and a reduced variable with a positive constant factor exists, the test is
+ * rewritten against that variable as long as i steps toward the bound and no product can overflow. An induction variable
+ * left feeding only its own update is then deleted.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any multiplication or exit test was rewritten, false otherwise
+ */
+bool Optimizer::strength_reduction(LLVMValueRef f) {
+    LLVMValueRef i, factor, init, step, t, t_next, cmp, bound, iv_operand, t_operand;
+    LLVMBuilderRef b;
+    LLVMBasicBlockRef bb;
+    const std::vector<Loop>* loops;
+    std::vector<Loop>::const_iterator loop_it;
+    std::vector<InductionVariable> ivs;
+    std::vector<InductionVariable>::iterator iv_it;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::vector<LLVMValueRef> muls;
+    std::vector<LLVMValueRef>::iterator mul_it;
+    std::unordered_map<LLVMValueRef, std::pair<LLVMValueRef, LLVMValueRef>> reduced;
+    std::unordered_map<LLVMValueRef, std::pair<LLVMValueRef, LLVMValueRef>>::iterator red_it;
+    LLVMIntPredicate pred;
+    long long c, lo, hi, n;
+    bool changes;
+    int k;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    b = LLVMCreateBuilder();
+    changes = false;
+    loops = &am.get_loops(f);
+
+    for (loop_it = loops->begin(); loop_it != loops->end(); ++loop_it) {
+        ivs = find_induction_variables(*loop_it);
+
+        for (iv_it = ivs.begin(); iv_it != ivs.end(); ++iv_it) {
+            // Multiplications of the variable, or of its update, by a loop-invariant factor.
+            muls.clear();
+            for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end(); ++bb_it)
+                for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = LLVMGetNextInstruction(i))
+                    if (LLVMGetInstructionOpcode(i) == LLVMMul)
+                        for (k = 0; k < 2; k++)
+                            if ((LLVMGetOperand(i, k) == iv_it->phi || LLVMGetOperand(i, k) == iv_it->update) && is_loop_invariant(LLVMGetOperand(i, 1 - k), *loop_it)) {
+                                muls.push_back(i);
+                                break;
+                            }
+
+            // One reduced variable per distinct factor.
+            reduced.clear();
+            for (mul_it = muls.begin(); mul_it != muls.end(); ++mul_it) {
+                k = LLVMGetOperand(*mul_it, 0) == iv_it->phi || LLVMGetOperand(*mul_it, 0) == iv_it->update ? 0 : 1;
+                factor = LLVMGetOperand(*mul_it, 1 - k);
+
+                if (!reduced.contains(factor)) {
+                    LLVMPositionBuilderBefore(b, LLVMGetBasicBlockTerminator(loop_it->preheader));
+                    init = LLVMBuildMul(b, iv_it->init, factor, "");
+                    step = LLVMBuildMul(b, LLVMConstInt(LLVMTypeOf(iv_it->phi), iv_it->step, 1), factor, "");
+
+                    LLVMPositionBuilderBefore(b, LLVMGetFirstInstruction(loop_it->header));
+                    t = LLVMBuildPhi(b, LLVMTypeOf(iv_it->phi), "");
+                    LLVMPositionBuilderBefore(b, LLVMGetNextInstruction(iv_it->update));
+                    t_next = LLVMBuildAdd(b, t, step, "");
+
+                    bb = loop_it->preheader;
+                    LLVMAddIncoming(t, &init, &bb, 1);
+                    bb = loop_it->latches[0];
+                    LLVMAddIncoming(t, &t_next, &bb, 1);
+
+                    reduced[factor] = std::make_pair(t, t_next);
+                }
+
+                record("strength-reduce.reduced", *mul_it);
+                if (LLVMGetOperand(*mul_it, k) == iv_it->phi) LLVMReplaceAllUsesWith(*mul_it, reduced[factor].first);
+                else LLVMReplaceAllUsesWith(*mul_it, reduced[factor].second);
+                LLVMInstructionEraseFromParent(*mul_it);
+                changes = true;
+            }
+
+            // Linear-function test replacement on the header's exit test.
+            cmp = LLVMGetLastInstruction(loop_it->header);
+            cmp = LLVMGetNumOperands(cmp) == 3 ? LLVMGetCondition(cmp) : NULL;
+            if (cmp == NULL || !LLVMIsAICmpInst(cmp) || LLVMGetFirstUse(cmp) == NULL || LLVMGetNextUse(LLVMGetFirstUse(cmp)) != NULL) continue;
+            if (!LLVMIsAConstantInt(iv_it->init)) continue;
+
+            for (k = 0; k < 2; k++) {
+                iv_operand = LLVMGetOperand(cmp, k);
+                bound = LLVMGetOperand(cmp, 1 - k);
+                if ((iv_operand == iv_it->phi || iv_operand == iv_it->update) && LLVMIsAConstantInt(bound)) break;
+            }
+            if (k == 2) continue;
+
+            // The loop must run while the variable approaches the bound.
+            pred = LLVMGetICmpPredicate(cmp);
+            if (k == 1) pred = swap_predicate(pred);
+            if (!loop_it->block_set.contains(LLVMValueAsBasicBlock(LLVMGetOperand(LLVMGetLastInstruction(loop_it->header), 2)))) pred = negate_predicate(pred);
+            if (!moves_toward_bound(pred, LLVMConstIntGetSExtValue(iv_it->init), iv_it->step, LLVMConstIntGetSExtValue(bound), iv_operand == iv_it->update)) continue;
+
+            t_operand = NULL;
+            for (red_it = reduced.begin(); red_it != reduced.end(); ++red_it) {
+                if (!LLVMIsAConstantInt(red_it->first) || LLVMConstIntGetSExtValue(red_it->first) <= 0) continue;
+
+                // The variable stays between its start and the bound, give or take one step.
+                c = LLVMConstIntGetSExtValue(red_it->first);
+                n = LLVMConstIntGetSExtValue(bound);
+                lo = std::min(LLVMConstIntGetSExtValue(iv_it->init), n) - std::llabs(iv_it->step);
+                hi = std::max(LLVMConstIntGetSExtValue(iv_it->init), n) + std::llabs(iv_it->step);
+                if (!product_fits(lo, hi, c)) continue;
+
+                factor = red_it->first;
+                t_operand = iv_operand == iv_it->phi ? red_it->second.first : red_it->second.second;
+                break;
+            }
+            if (t_operand == NULL) continue;
+
+            LLVMSetOperand(cmp, k, t_operand);
+            LLVMSetOperand(cmp, 1 - k, LLVMConstInt(LLVMTypeOf(bound), LLVMConstIntGetSExtValue(bound) * LLVMConstIntGetSExtValue(factor), 1));
+            changes = true;
+
+            // Drop the old variable once only its own update uses it.
+            if (LLVMGetFirstUse(iv_it->update) != NULL && LLVMGetNextUse(LLVMGetFirstUse(iv_it->update)) == NULL && LLVMGetUser(LLVMGetFirstUse(iv_it->update)) == iv_it->phi
+                && LLVMGetFirstUse(iv_it->phi) != NULL && LLVMGetNextUse(LLVMGetFirstUse(iv_it->phi)) == NULL && LLVMGetUser(LLVMGetFirstUse(iv_it->phi)) == iv_it->update) {
+                LLVMReplaceAllUsesWith(iv_it->update, LLVMGetUndef(LLVMTypeOf(iv_it->update)));
+                LLVMInstructionEraseFromParent(iv_it->update);
+                LLVMInstructionEraseFromParent(iv_it->phi);
+            }
+        }
+    }
+
+    LLVMDisposeBuilder(b);
+
+    if (changes) am.invalidate(f, PRESERVE_CFG | PRESERVE_REACHING_STORES | PRESERVE_LIVE_LOADS);
+
+    return changes;
+}
+
+/*
+ * Replaces counting loops by the closed form of their exit values.
+ * A loop qualifies when it has no inner loops, calls or stores, exits only from its header through a test of a basic
+ * induction variable against a loop-invariant bound, and every header phi used after the loop is a sum recurrence.
+ * The trip count comes from the test; with a non-constant bound the step must be one in the direction of the bound.
+ * The header keeps its test on the initial values, and its loop edge goes to a new block computing
+ * x0 + N * t for invariant terms and N * j0 + s * N(N -/+ 1) / 2 for induction variable terms.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if a loop was replaced, false otherwise
+ */
+bool Optimizer::scalar_evolution(LLVMValueRef f) {
+    LLVMValueRef i, next, term, cmp, iv_operand, bound, n, val, acc, contrib, exit_phi;
+    LLVMBuilderRef b;
+    LLVMBasicBlockRef body, exit_bb, closed, bb;
+    LLVMIntPredicate pred;
+    LLVMUseRef use;
+    LLVMTypeRef ty;
+    const std::vector<Loop>* loops;
+    std::vector<Loop>::const_iterator loop_it, other_it;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::vector<InductionVariable> ivs;
+    const InductionVariable* iv;
+    const InductionVariable* term_iv;
+    std::vector<Recurrence> recs;
+    std::vector<Recurrence>::iterator rec_it;
+    std::vector<std::pair<LLVMValueRef, bool>>::iterator term_it;
+    std::optional<Recurrence> rec_opt;
+    std::vector<LLVMValueRef> exit_vals;
+    std::vector<LLVMBasicBlockRef> succs;
+    std::unordered_set<LLVMValueRef> users;
+    std::unordered_set<LLVMValueRef>::iterator user_it;
+    long long lo, hi, step, trip;
+    bool ok, in_loop_on_true;
+    int k, op;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    loops = &am.get_loops(f);
+
+    for (loop_it = loops->begin(); loop_it != loops->end(); ++loop_it) {
+        if (loop_it->preheader == NULL || loop_it->latches.size() != 1) continue;
+
+        // Innermost loops only.
+        ok = true;
+        for (other_it = loops->begin(); other_it != loops->end() && ok; ++other_it)
+            if (other_it->header != loop_it->header && loop_it->block_set.contains(other_it->header)) ok = false;
+        if (!ok) continue;
+
+        // Header must be the only exit, through a conditional branch.
+        term = LLVMGetBasicBlockTerminator(loop_it->header);
+        if (LLVMGetNumOperands(term) != 3) continue;
+        in_loop_on_true = loop_it->block_set.contains(LLVMValueAsBasicBlock(LLVMGetOperand(term, 2)));
+        body = LLVMValueAsBasicBlock(LLVMGetOperand(term, in_loop_on_true ? 2 : 1));
+        exit_bb = LLVMValueAsBasicBlock(LLVMGetOperand(term, in_loop_on_true ? 1 : 2));
+        if (loop_it->block_set.contains(exit_bb) || !loop_it->block_set.contains(body)) continue;
+        if (am.get_preds(f).at(exit_bb).size() != 1 || (LLVMGetFirstInstruction(exit_bb) != NULL && LLVMGetInstructionOpcode(LLVMGetFirstInstruction(exit_bb)) == LLVMPHI)) continue;
+
+        // No side effects, no other exits, and only header phis used outside.
+        for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end() && ok; ++bb_it) {
+            if (*bb_it != loop_it->header) {
+                succs = get_successors(*bb_it);
+                for (k = 0; k < (int)succs.size(); k++)
+                    if (!loop_it->block_set.contains(succs[k])) ok = false;
+            }
+            for (i = LLVMGetFirstInstruction(*bb_it); i != NULL && ok; i = LLVMGetNextInstruction(i)) {
+                if (LLVMGetInstructionOpcode(i) == LLVMCall || LLVMGetInstructionOpcode(i) == LLVMStore) ok = false;
+                if (LLVMGetInstructionOpcode(i) == LLVMPHI) continue;
+                for (use = LLVMGetFirstUse(i); use != NULL && ok; use = LLVMGetNextUse(use))
+                    if (!loop_it->block_set.contains(LLVMGetInstructionParent(LLVMGetUser(use)))) ok = false;
+            }
+        }
+        if (!ok) continue;
+
+        // Exit test on an induction variable, normalised to "stay while iv pred bound".
+        cmp = LLVMGetCondition(term);
+        if (!LLVMIsAICmpInst(cmp)) continue;
+        ivs = find_induction_variables(*loop_it);
+        iv_operand = LLVMGetOperand(cmp, 0);
+        bound = LLVMGetOperand(cmp, 1);
+        pred = LLVMGetICmpPredicate(cmp);
+        if (find_iv(iv_operand, ivs) == NULL || find_iv(iv_operand, ivs)->phi != iv_operand) {
+            std::swap(iv_operand, bound);
+            pred = swap_predicate(pred);
+        }
+        if ((iv = find_iv(iv_operand, ivs)) == NULL || iv->phi != iv_operand || !is_loop_invariant(bound, *loop_it)) continue;
+        if (!in_loop_on_true) pred = negate_predicate(pred);
+
+        // Trip count, given that the loop is entered: exact for constants, unit steps otherwise.
+        step = iv->step;
+        trip = -1;
+        if (LLVMIsAConstantInt(iv->init) && LLVMIsAConstantInt(bound)) {
+            lo = LLVMConstIntGetSExtValue(iv->init);
+            hi = LLVMConstIntGetSExtValue(bound);
+            if ((pred == LLVMIntSLT || pred == LLVMIntSLE) && step > 0) trip = (hi - lo + (pred == LLVMIntSLE ? 1 : 0) + step - 1) / step;
+            else if ((pred == LLVMIntSGT || pred == LLVMIntSGE) && step < 0) trip = (lo - hi + (pred == LLVMIntSGE ? 1 : 0) - step - 1) / -step;
+            else if (pred == LLVMIntNE && step != 0 && (hi - lo) % step == 0 && (hi - lo) / step > 0) trip = (hi - lo) / step;
+            if (trip < 0 || lo + trip * step < INT32_MIN || lo + trip * step > INT32_MAX) continue;
+        } else if (!(((pred == LLVMIntSLT || pred == LLVMIntSLE) && step == 1) || ((pred == LLVMIntSGT || pred == LLVMIntSGE) && step == -1) || (pred == LLVMIntNE && (step == 1 || step == -1))))
+            continue;
+
+        // Every header phi used after the loop needs a closed form.
+        recs.clear();
+        for (i = LLVMGetFirstInstruction(loop_it->header); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI && ok; i = LLVMGetNextInstruction(i)) {
+            for (use = LLVMGetFirstUse(i); use != NULL; use = LLVMGetNextUse(use))
+                if (!loop_it->block_set.contains(LLVMGetInstructionParent(LLVMGetUser(use)))) break;
+            if (use == NULL) continue;
+
+            if (!(rec_opt = find_recurrence(i, *loop_it, ivs)).has_value()) ok = false;
+            else recs.push_back(rec_opt.value());
+        }
+        if (!ok) continue;
+
+        // Closed-form block on the loop edge of the header.
+        ty = LLVMTypeOf(iv->phi);
+        closed = LLVMInsertBasicBlock(exit_bb, "");
+        b = LLVMCreateBuilder();
+        LLVMPositionBuilderAtEnd(b, closed);
+
+        if (trip >= 0) n = LLVMConstInt(ty, trip, 0);
+        else if (step == 1) n = LLVMBuildSub(b, bound, iv->init, "");
+        else n = LLVMBuildSub(b, iv->init, bound, "");
+        if (trip < 0 && (pred == LLVMIntSLE || pred == LLVMIntSGE)) n = LLVMBuildAdd(b, n, LLVMConstInt(ty, 1, 0), "");
+
+        exit_vals.clear();
+        for (rec_it = recs.begin(); rec_it != recs.end(); ++rec_it) {
+            acc = rec_it->start;
+            for (term_it = rec_it->terms.begin(); term_it != rec_it->terms.end(); ++term_it) {
+                if (is_loop_invariant(term_it->first, *loop_it)) contrib = LLVMBuildMul(b, n, term_it->first, "");
+                else {
+                    // Sum of j0 + k * s over the iterations, k counting from 0 for the phi and from 1 for the update.
+                    term_iv = find_iv(term_it->first, ivs);
+                    if (term_it->first == term_iv->phi) val = build_triangular(b, n);
+                    else val = build_triangular(b, LLVMBuildAdd(b, n, LLVMConstInt(ty, 1, 0), ""));
+                    contrib = LLVMBuildAdd(b, LLVMBuildMul(b, n, term_iv->init, ""), LLVMBuildMul(b, val, LLVMConstInt(ty, term_iv->step, 1), ""), "");
+                }
+                acc = term_it->second ? LLVMBuildAdd(b, acc, contrib, "") : LLVMBuildSub(b, acc, contrib, "");
+            }
+            exit_vals.push_back(acc);
+        }
+        LLVMBuildBr(b, exit_bb);
+
+        // Exit values merge the skipped-loop case from the header with the closed forms.
+        for (k = 0; k < (int)recs.size(); k++) {
+            if (LLVMGetFirstInstruction(exit_bb) != NULL) LLVMPositionBuilderBefore(b, LLVMGetFirstInstruction(exit_bb));
+            else LLVMPositionBuilderAtEnd(b, exit_bb);
+            exit_phi = LLVMBuildPhi(b, ty, "");
+            bb = loop_it->header;
+            LLVMAddIncoming(exit_phi, &recs[k].start, &bb, 1);
+            LLVMAddIncoming(exit_phi, &exit_vals[k], &closed, 1);
+
+            users.clear();
+            for (use = LLVMGetFirstUse(recs[k].phi); use != NULL; use = LLVMGetNextUse(use))
+                if (!loop_it->block_set.contains(LLVMGetInstructionParent(LLVMGetUser(use)))) users.insert(LLVMGetUser(use));
+            for (user_it = users.begin(); user_it != users.end(); ++user_it)
+                for (op = 0; op < LLVMGetNumOperands(*user_it); op++)
+                    if (LLVMGetOperand(*user_it, op) == recs[k].phi) LLVMSetOperand(*user_it, op, exit_phi);
+        }
+        LLVMDisposeBuilder(b);
+
+        // Header runs once on the initial values and leaves through the closed form.
+        for (i = LLVMGetFirstInstruction(loop_it->header); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = next) {
+            next = LLVMGetNextInstruction(i);
+            for (op = 0; op < (int)LLVMCountIncoming(i); op++)
+                if (LLVMGetIncomingBlock(i, op) == loop_it->preheader) val = LLVMGetIncomingValue(i, op);
+            LLVMReplaceAllUsesWith(i, val);
+            LLVMInstructionEraseFromParent(i);
+        }
+        LLVMSetOperand(term, in_loop_on_true ? 2 : 1, LLVMBasicBlockAsValue(closed));
+
+        // Delete the body.
+        for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end(); ++bb_it) {
+            if (*bb_it == loop_it->header) continue;
+            for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = LLVMGetNextInstruction(i))
+                LLVMReplaceAllUsesWith(i, LLVMGetUndef(LLVMTypeOf(i)));
+        }
+        for (bb_it = loop_it->blocks.begin(); bb_it != loop_it->blocks.end(); ++bb_it)
+            if (*bb_it != loop_it->header) LLVMDeleteBasicBlock(*bb_it);
+
+        record("scev.loops_replaced", LLVMBasicBlockAsValue(loop_it->header));
+        am.invalidate(f, PRESERVE_NONE);
+
+        // Loop list is stale now; the driver calls again for the remaining loops.
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Performs sparse conditional constant propagation.
+ * Values start undefined and only move down the lattice. Only instructions in blocks reached through executable edges
+ * are evaluated, so constants flowing around untaken branches do not spoil phis. An instruction is re-evaluated only
+ * when one of its operands changes and phis also when a new incoming edge becomes executable.
+ * Afterwards constant instructions are replaced, branches on constants become unconditional and unreached blocks are
+ * deleted.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any instruction, branch or block was removed, false otherwise
+ */
+bool Optimizer::sparse_conditional_constant_propagation(LLVMValueRef f) {
+    LLVMValueRef i, next, br;
+    LLVMBasicBlockRef bb, succ, taken;
+    LLVMBuilderRef b;
+    LLVMUseRef use;
+    LLVMOpcode op;
+    std::unordered_map<LLVMValueRef, LatticeValue> lattice;
+    std::unordered_set<LLVMBasicBlockRef> executable;
+    std::set<std::pair<LLVMBasicBlockRef, LLVMBasicBlockRef>> executable_edges;
+    std::vector<std::pair<LLVMBasicBlockRef, LLVMBasicBlockRef>> cfg_work;
+    std::vector<LLVMValueRef> ssa_work, deletions;
+    std::vector<LLVMValueRef>::iterator del_it;
+    std::vector<std::pair<LLVMValueRef, bool>> folds;
+    std::vector<std::pair<LLVMValueRef, bool>>::iterator fold_it;
+    std::vector<LLVMBasicBlockRef> succs, dead_blocks;
+    std::vector<LLVMBasicBlockRef>::iterator succ_it, bb_it;
+    std::pair<LLVMBasicBlockRef, LLVMBasicBlockRef> edge;
+    LatticeValue old_val, new_val, a, c;
+    long long result;
+    bool changes, cfg_changed;
+    unsigned int k;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if ((bb = LLVMGetEntryBasicBlock(f)) == NULL) return false;
+
+    cfg_work.push_back(std::make_pair((LLVMBasicBlockRef)NULL, bb));
+
+    while (!cfg_work.empty() || !ssa_work.empty()) {
+        // Evaluate the instructions of a block on its first executable edge, only its phis afterwards.
+        if (!cfg_work.empty()) {
+            edge = cfg_work.back();
+            cfg_work.pop_back();
+            if (executable_edges.contains(edge)) continue;
+            executable_edges.insert(edge);
+
+            if (executable.contains(edge.second)) {
+                for (i = LLVMGetFirstInstruction(edge.second); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = LLVMGetNextInstruction(i))
+                    ssa_work.push_back(i);
+                continue;
+            }
+
+            executable.insert(edge.second);
+            for (i = LLVMGetFirstInstruction(edge.second); i != NULL; i = LLVMGetNextInstruction(i))
+                ssa_work.push_back(i);
+            continue;
+        }
+
+        i = ssa_work.back();
+        ssa_work.pop_back();
+        bb = LLVMGetInstructionParent(i);
+        if (!executable.contains(bb)) continue;
+
+        op = LLVMGetInstructionOpcode(i);
+
+        // Branches make the edges they may take executable.
+        if (op == LLVMBr) {
+            if (LLVMGetNumOperands(i) == 1) cfg_work.push_back(std::make_pair(bb, LLVMValueAsBasicBlock(LLVMGetOperand(i, 0))));
+            else {
+                c = get_lattice(LLVMGetCondition(i), lattice);
+                if (c.kind == LatticeKind::Undefined) continue;
+                if (c.kind == LatticeKind::Overdefined || c.value != 0) cfg_work.push_back(std::make_pair(bb, LLVMValueAsBasicBlock(LLVMGetOperand(i, 2))));
+                if (c.kind == LatticeKind::Overdefined || c.value == 0) cfg_work.push_back(std::make_pair(bb, LLVMValueAsBasicBlock(LLVMGetOperand(i, 1))));
+            }
+            continue;
+        }
+        if (LLVMIsATerminatorInst(i)) {
+            succs = get_successors(bb);
+            for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it) cfg_work.push_back(std::make_pair(bb, *succ_it));
+            continue;
+        }
+
+        if (LLVMGetTypeKind(LLVMTypeOf(i)) == LLVMVoidTypeKind) continue;
+
+        // New lattice value of the instruction.
+        if (op == LLVMPHI) {
+            new_val = LatticeValue{LatticeKind::Undefined, 0};
+            for (k = 0; k < LLVMCountIncoming(i); k++)
+                if (executable_edges.contains(std::make_pair(LLVMGetIncomingBlock(i, k), bb)))
+                    new_val = meet_lattice(new_val, get_lattice(LLVMGetIncomingValue(i, k), lattice));
+        } else if ((op == LLVMAdd || op == LLVMSub || op == LLVMMul || op == LLVMSDiv || op == LLVMSRem || op == LLVMAnd || op == LLVMShl || op == LLVMLShr || op == LLVMICmp) && LLVMGetTypeKind(LLVMTypeOf(LLVMGetOperand(i, 0))) == LLVMIntegerTypeKind && LLVMGetIntTypeWidth(LLVMTypeOf(LLVMGetOperand(i, 0))) == 32) {
+            a = get_lattice(LLVMGetOperand(i, 0), lattice);
+            c = get_lattice(LLVMGetOperand(i, 1), lattice);
+            if (a.kind == LatticeKind::Overdefined || c.kind == LatticeKind::Overdefined) new_val = LatticeValue{LatticeKind::Overdefined, 0};
+            else if (a.kind == LatticeKind::Undefined || c.kind == LatticeKind::Undefined) new_val = LatticeValue{LatticeKind::Undefined, 0};
+            else if (fold_binary(i, a.value, c.value, result)) new_val = LatticeValue{LatticeKind::Constant, result};
+            else new_val = LatticeValue{LatticeKind::Overdefined, 0};
+        } else new_val = LatticeValue{LatticeKind::Overdefined, 0};
+
+        // Values only move down the lattice; users are revisited when they do.
+        old_val = get_lattice(i, lattice);
+        new_val = meet_lattice(old_val, new_val);
+        if (new_val.kind == old_val.kind && new_val.value == old_val.value) continue;
+
+        lattice[i] = new_val;
+        for (use = LLVMGetFirstUse(i); use != NULL; use = LLVMGetNextUse(use))
+            ssa_work.push_back(LLVMGetUser(use));
+    }
+
+    changes = false;
+    cfg_changed = false;
+
+    // Replace constants and pick the branches to fold while every lattice entry still names a live instruction:
+    // removing phi incomings rebuilds phis, which may reuse the addresses of erased ones.
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        if (!executable.contains(bb)) {
+            dead_blocks.push_back(bb);
+            continue;
+        }
+
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i)) {
+            c = get_lattice(i, lattice);
+            if (c.kind != LatticeKind::Constant || LLVMGetInstructionOpcode(i) == LLVMCall) continue;
+            record("sccp.folded", i);
+            LLVMReplaceAllUsesWith(i, LLVMConstInt(LLVMTypeOf(i), c.value, 1));
+            deletions.push_back(i);
+        }
+
+        // Conditional branches with a single executable edge become unconditional.
+        br = LLVMGetBasicBlockTerminator(bb);
+        if (br == NULL || LLVMGetInstructionOpcode(br) != LLVMBr || LLVMGetNumOperands(br) != 3) continue;
+        c = get_lattice(LLVMGetCondition(br), lattice);
+        if (c.kind == LatticeKind::Constant) folds.push_back(std::make_pair(br, c.value != 0));
+    }
+
+    // Folded instructions have no uses left.
+    for (del_it = deletions.begin(); del_it != deletions.end(); ++del_it)
+        LLVMInstructionEraseFromParent(*del_it);
+
+    b = LLVMCreateBuilder();
+
+    for (fold_it = folds.begin(); fold_it != folds.end(); ++fold_it) {
+        br = fold_it->first;
+        bb = LLVMGetInstructionParent(br);
+        taken = LLVMValueAsBasicBlock(LLVMGetOperand(br, fold_it->second ? 2 : 1));
+        succ = LLVMValueAsBasicBlock(LLVMGetOperand(br, fold_it->second ? 1 : 2));
+        record("sccp.branches_folded", br);
+        LLVMPositionBuilderBefore(b, br);
+        LLVMBuildBr(b, taken);
+        LLVMInstructionEraseFromParent(br);
+        if (succ != taken) remove_phi_incoming(succ, bb);
+        cfg_changed = true;
+    }
+
+    LLVMDisposeBuilder(b);
+
+    // Unreached blocks go, along with their phi entries in reached successors.
+    for (bb_it = dead_blocks.begin(); bb_it != dead_blocks.end(); ++bb_it) {
+        succs = get_successors(*bb_it);
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it)
+            if (executable.contains(*succ_it)) remove_phi_incoming(*succ_it, *bb_it);
+        for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = next) {
+            next = LLVMGetNextInstruction(i);
+            LLVMReplaceAllUsesWith(i, LLVMGetUndef(LLVMTypeOf(i)));
+        }
+    }
+    for (bb_it = dead_blocks.begin(); bb_it != dead_blocks.end(); ++bb_it) {
+        LLVMDeleteBasicBlock(*bb_it);
+        cfg_changed = true;
+    }
+
+    changes = cfg_changed || !deletions.empty();
+
+    if (cfg_changed) am.invalidate(f, PRESERVE_NONE);
+    else if (changes) am.invalidate(f, PRESERVE_CFG | PRESERVE_REACHING_STORES);
+
+    return changes;
+}
+
+/*
+ * Simplifies the control-flow graph until nothing changes:
+ * - deletes blocks unreachable from the entry,
+ * - turns conditional branches with identical targets into unconditional ones,
+ * - merges a block into its predecessor when it is that predecessor's only successor and has no other predecessor,
+ * - removes empty forwarding blocks by sending their predecessors straight to the target, which also threads jumps
+ *   to jumps. Loop preheaders are kept so that loop-invariant code motion does not keep recreating them.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if the CFG changed, false otherwise
+ */
+bool Optimizer::simplify_cfg(LLVMValueRef f) {
+    LLVMValueRef i, next, term, val;
+    LLVMBasicBlockRef bb, next_bb, succ, in_bb;
+    LLVMBuilderRef b;
+    const std::vector<Loop>* loops;
+    std::vector<Loop>::const_iterator loop_it;
+    std::unordered_set<LLVMBasicBlockRef> reachable, preheaders;
+    std::vector<LLVMBasicBlockRef> work, succs, bb_preds;
+    std::vector<LLVMBasicBlockRef>::iterator succ_it, pred_it;
+    bool changes, local_changes, safe;
+    unsigned int k;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    loops = &am.get_loops(f);
+    for (loop_it = loops->begin(); loop_it != loops->end(); ++loop_it)
+        if (loop_it->preheader != NULL) preheaders.insert(loop_it->preheader);
+
+    b = LLVMCreateBuilder();
+    changes = false;
+
+    do {
+        local_changes = false;
+
+        // Unreachable blocks.
+        reachable.clear();
+        work.clear();
+        work.push_back(LLVMGetEntryBasicBlock(f));
+        while (!work.empty()) {
+            bb = work.back();
+            work.pop_back();
+            if (reachable.contains(bb)) continue;
+            reachable.insert(bb);
+            succs = get_successors(bb);
+            work.insert(work.end(), succs.begin(), succs.end());
+        }
+        for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = next_bb) {
+            next_bb = LLVMGetNextBasicBlock(bb);
+            if (reachable.contains(bb)) continue;
+
+            succs = get_successors(bb);
+            for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it)
+                if (reachable.contains(*succ_it)) remove_phi_incoming(*succ_it, bb);
+            record("simplifycfg.unreachable_removed", LLVMBasicBlockAsValue(bb));
+            for (i = LLVMGetFirstInstruction(bb); i != NULL; i = LLVMGetNextInstruction(i))
+                LLVMReplaceAllUsesWith(i, LLVMGetUndef(LLVMTypeOf(i)));
+            LLVMDeleteBasicBlock(bb);
+            local_changes = true;
+        }
+
+        for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = next_bb) {
+            next_bb = LLVMGetNextBasicBlock(bb);
+            term = LLVMGetBasicBlockTerminator(bb);
+            if (term == NULL || LLVMGetInstructionOpcode(term) != LLVMBr) continue;
+
+            // Conditional branch to one block.
+            if (LLVMGetNumOperands(term) == 3 && LLVMGetOperand(term, 1) == LLVMGetOperand(term, 2)) {
+                record("simplifycfg.branches_simplified", term);
+                succ = LLVMValueAsBasicBlock(LLVMGetOperand(term, 1));
+                LLVMPositionBuilderBefore(b, term);
+                LLVMBuildBr(b, succ);
+                LLVMInstructionEraseFromParent(term);
+                local_changes = true;
+                continue;
+            }
+            if (LLVMGetNumOperands(term) != 1) continue;
+
+            succ = LLVMValueAsBasicBlock(LLVMGetOperand(term, 0));
+            if (succ == bb || succ == LLVMGetEntryBasicBlock(f)) continue;
+
+            bb_preds = get_predecessors(succ);
+
+            // Single successor with a single predecessor: append it to this block and look at the result again.
+            if (bb_preds.size() == 1) {
+                record("simplifycfg.blocks_merged", LLVMBasicBlockAsValue(succ));
+                LLVMReplaceAllUsesWith(LLVMBasicBlockAsValue(succ), LLVMBasicBlockAsValue(bb));
+                LLVMInstructionEraseFromParent(term);
+                for (i = LLVMGetFirstInstruction(succ); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = next) {
+                    next = LLVMGetNextInstruction(i);
+                    LLVMReplaceAllUsesWith(i, LLVMGetIncomingValue(i, 0));
+                    LLVMInstructionEraseFromParent(i);
+                }
+                LLVMPositionBuilderAtEnd(b, bb);
+                for (i = LLVMGetFirstInstruction(succ); i != NULL; i = next) {
+                    next = LLVMGetNextInstruction(i);
+                    LLVMInstructionRemoveFromParent(i);
+                    LLVMInsertIntoBuilder(b, i);
+                }
+                if (preheaders.contains(succ)) {
+                    preheaders.erase(succ);
+                    preheaders.insert(bb);
+                }
+                LLVMDeleteBasicBlock(succ);
+                local_changes = true;
+                next_bb = bb;
+                continue;
+            }
+
+            // Empty forwarding block: predecessors jump straight to its target.
+            if (LLVMGetFirstInstruction(bb) != term || bb == LLVMGetEntryBasicBlock(f) || preheaders.contains(bb)) continue;
+
+            bb_preds = get_predecessors(bb);
+            succs = get_predecessors(succ);
+            safe = !bb_preds.empty();
+            if (LLVMGetFirstInstruction(succ) != NULL && LLVMGetInstructionOpcode(LLVMGetFirstInstruction(succ)) == LLVMPHI)
+                for (pred_it = bb_preds.begin(); pred_it != bb_preds.end() && safe; ++pred_it)
+                    if (std::find(succs.begin(), succs.end(), *pred_it) != succs.end()) safe = false;
+            if (!safe) continue;
+
+            // The value a target phi received from the forwarding block now comes from each of its predecessors.
+            record("simplifycfg.forwarders_removed", LLVMBasicBlockAsValue(bb));
+            for (i = LLVMGetFirstInstruction(succ); i != NULL && LLVMGetInstructionOpcode(i) == LLVMPHI; i = LLVMGetNextInstruction(i)) {
+                val = NULL;
+                for (k = 0; k < LLVMCountIncoming(i); k++)
+                    if (LLVMGetIncomingBlock(i, k) == bb) val = LLVMGetIncomingValue(i, k);
+                for (pred_it = bb_preds.begin(); pred_it != bb_preds.end(); ++pred_it) {
+                    in_bb = *pred_it;
+                    LLVMAddIncoming(i, &val, &in_bb, 1);
+                }
+            }
+            remove_phi_incoming(succ, bb);
+
+            for (pred_it = bb_preds.begin(); pred_it != bb_preds.end(); ++pred_it) {
+                term = LLVMGetBasicBlockTerminator(*pred_it);
+                for (k = 0; k < LLVMGetNumSuccessors(term); k++)
+                    if (LLVMGetSuccessor(term, k) == bb) LLVMSetSuccessor(term, k, succ);
+            }
+            LLVMDeleteBasicBlock(bb);
+            local_changes = true;
+        }
+
+        if (local_changes) changes = true;
+    } while (local_changes);
+
+    LLVMDisposeBuilder(b);
+
+    if (changes) am.invalidate(f, PRESERVE_NONE);
+
+    return changes;
+}
+
+/*
+ * Performs peephole simplification with the instcombine rule table.
+ * The first rule that applies to an instruction rewrites it, and the instruction is tried again until no rule applies.
+ * The number of times each rule fired is recorded.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any rule fired, false otherwise
+ */
+bool Optimizer::instruction_combining(LLVMValueRef f) {
+    LLVMValueRef i, next, repl;
+    LLVMBasicBlockRef bb;
+    LLVMBuilderRef b;
+    size_t r, num_rules;
+    bool changes, fired;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    b = LLVMCreateBuilder();
+    changes = false;
+    num_rules = sizeof(instcombine_rules) / sizeof(instcombine_rules[0]);
+
+    for (bb = LLVMGetFirstBasicBlock(f); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (i = LLVMGetFirstInstruction(bb); i != NULL; i = next) {
+            next = LLVMGetNextInstruction(i);
+            if (LLVMGetTypeKind(LLVMTypeOf(i)) != LLVMIntegerTypeKind) continue;
+
+            do {
+                fired = false;
+                for (r = 0; r < num_rules && !fired; r++) {
+                    LLVMPositionBuilderBefore(b, i);
+                    if ((repl = instcombine_rules[r].second(i, b)) == NULL) continue;
+
+                    record(std::string("instcombine.") + instcombine_rules[r].first, i);
+                    fired = true;
+                    changes = true;
+
+                    // Replacements built before i are visited again through the new instruction.
+                    if (repl != i) {
+                        LLVMReplaceAllUsesWith(i, repl);
+                        LLVMInstructionEraseFromParent(i);
+                        if (LLVMIsAInstruction(repl) && LLVMGetInstructionParent(repl) == bb && LLVMGetNextInstruction(repl) == next) i = repl;
+                        else i = NULL;
+                    }
+                }
+            } while (fired && i != NULL);
+        }
+    }
+
+    LLVMDisposeBuilder(b);
+
+    if (changes) am.invalidate(f, PRESERVE_CFG | PRESERVE_REACHING_STORES | PRESERVE_LIVE_LOADS);
+
+    return changes;
+}
+
+/*
+ * Performs global dead store elimination.
+ * A store is dead when no load of its location is live after it, using the live loads dataflow solution, or when it
+ * writes back the value just loaded from the same location. Allocas left with only stores are removed together with
+ * those stores, so they no longer take a stack slot.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any store or alloca was removed, false otherwise
+ */
+bool Optimizer::dead_store_elimination(LLVMValueRef f) {
+    LLVMValueRef i, next, val;
+    LLVMUseRef use;
+    const MemoryDataflow* live;
+    BitVector r;
+    std::vector<size_t> loads;
+    std::vector<size_t>::iterator vec_it;
+    std::set<LLVMValueRef>::iterator set_it;
+    std::set<LLVMValueRef> deletions;
+    std::vector<LLVMValueRef> allocas;
+    std::vector<LLVMValueRef>::iterator alloca_it;
+    bool only_stores;
+    size_t b;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    if ((live = am.get_live_loads(f)) == NULL) return false;
+
+    for (b = 0; b < live->num.blocks.size(); b++) {
+        // Add OUT[B] to R.
+        r = live->out[b];
+
+        // Begin at last instruction in the basic block and work backwards.
+        for (i = LLVMGetLastInstruction(live->num.blocks[b]); i != NULL; i = LLVMGetPreviousInstruction(i)) {
+            if (LLVMGetInstructionOpcode(i) == LLVMLoad)
+                // Add load instruction to R.
+                r.set(live->num.instr_num.at(i));
+            else if (LLVMGetInstructionOpcode(i) == LLVMStore) {
+                // Check if any load instructions rely on this store instruction.
+                loads = find_instrs_with_operand(r, live->num, LLVMGetOperand(i, 1));
+
+                // Remove load instructions from R since their correspinding store ahs been found.
+                if (!loads.empty()) for (vec_it = loads.begin(); vec_it != loads.end(); ++vec_it) r.reset(*vec_it);
+                    // Mark store instruction for deletion if no load instructions depend on it.
+                else deletions.insert(i);
+
+                // Storing the value just loaded from the same location changes nothing.
+                val = LLVMGetOperand(i, 0);
+                if (LLVMIsAInstruction(val) && LLVMGetInstructionOpcode(val) == LLVMLoad && LLVMGetOperand(val, 0) == LLVMGetOperand(i, 1) && LLVMGetNextInstruction(val) == i)
+                    deletions.insert(i);
+            }
+        }
+    }
+
+    // Delete all marked store instructions.
+    for (set_it = deletions.begin(); set_it != deletions.end(); ++set_it) {
+        record("dse.stores_removed", *set_it);
+        LLVMInstructionEraseFromParent(*set_it);
+    }
+
+    // Allocas whose only uses are stores into them.
+    for (i = LLVMGetFirstInstruction(LLVMGetEntryBasicBlock(f)); i != NULL; i = LLVMGetNextInstruction(i)) {
+        if (LLVMGetInstructionOpcode(i) != LLVMAlloca) continue;
+
+        only_stores = true;
+        for (use = LLVMGetFirstUse(i); use != NULL && only_stores; use = LLVMGetNextUse(use))
+            if (LLVMGetInstructionOpcode(LLVMGetUser(use)) != LLVMStore || LLVMGetOperand(LLVMGetUser(use), 1) != i) only_stores = false;
+        if (only_stores) allocas.push_back(i);
+    }
+    for (alloca_it = allocas.begin(); alloca_it != allocas.end(); ++alloca_it) {
+        while ((use = LLVMGetFirstUse(*alloca_it)) != NULL) {
+            next = LLVMGetUser(use);
+            record("dse.stores_removed", next);
+            LLVMInstructionEraseFromParent(next);
+        }
+        record("dse.allocas_removed", *alloca_it);
+        LLVMInstructionEraseFromParent(*alloca_it);
+    }
+
+    // Only stores and allocas were removed.
+    if (!deletions.empty() || !allocas.empty()) am.invalidate(f, PRESERVE_CFG);
+
+    return !deletions.empty() || !allocas.empty();
+}
+
+/*
+ * Performs aggressive (mark and sweep) dead code elimination.
+ * Everything starts dead except returns, calls, stores outside local allocas and the branches of blocks that never reach
+ * a return. Liveness then flows to the operands of live instructions, to every store of an alloca whose load is live,
+ * to the branches a live block is control dependent on (its post-dominance frontier) and to the branches feeding the
+ * incoming edges of live phis. Dead instructions are deleted and dead conditional branches jump straight to their
+ * immediate post-dominator, so loops computing only unused values disappear entirely.
+ *
+ * Args:
+ * - f (LLVMValueRef): function on which to perform optimizations
+ *
+ * Returns:
+ * - True if any instruction was removed or branch rewritten, false otherwise
+ */
+bool Optimizer::aggressive_dead_code_elim(LLVMValueRef f) {
+    LLVMBuilderRef b;
+    LLVMValueRef i, v, term;
+    LLVMBasicBlockRef bb, target;
+    LLVMOpcode op;
+    LLVMUseRef use;
+    std::unordered_set<LLVMValueRef> live;
+    std::unordered_set<LLVMBasicBlockRef> live_blocks, reachable, returning;
+    std::vector<LLVMValueRef> worklist, dead, branches;
+    std::vector<LLVMValueRef>::iterator instr_it;
+    std::vector<LLVMBasicBlockRef> succs, block_work;
+    std::vector<LLVMBasicBlockRef>::const_iterator bb_it;
+    std::vector<LLVMBasicBlockRef>::iterator succ_it;
+    std::set<LLVMBasicBlockRef>::const_iterator pdf_it;
+    unsigned int k;
+
+    if (f == NULL) {
+        std::cerr << "Invalid argument to function.\n";
+        return false;
+    }
+
+    if (LLVMGetFirstBasicBlock(f) == NULL) return false;
+
+    const std::vector<LLVMBasicBlockRef>& rpo = am.get_rpo(f);
+    const std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef>& ipdom = am.get_post_idoms(f);
+    const std::unordered_map<LLVMBasicBlockRef, std::set<LLVMBasicBlockRef>>& pdf = am.get_post_dominance_frontiers(f);
+    const std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>& preds = am.get_preds(f);
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) reachable.insert(*bb_it);
+
+    // Find the blocks that can reach a return by walking backwards from the blocks without successors.
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it)
+        if (get_successors(*bb_it).empty()) {
+            returning.insert(*bb_it);
+            block_work.push_back(*bb_it);
+        }
+    while (!block_work.empty()) {
+        bb = block_work.back();
+        block_work.pop_back();
+        for (bb_it = preds.at(bb).begin(); bb_it != preds.at(bb).end(); ++bb_it)
+            if (reachable.contains(*bb_it) && !returning.contains(*bb_it)) {
+                returning.insert(*bb_it);
+                block_work.push_back(*bb_it);
+            }
+    }
+
+    // Seed with instructions whose effects are observable.
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) {
+        // Branches of blocks that never reach a return keep their (possibly infinite) loops, and through control
+        // dependence the branches that lead into them.
+        if (!returning.contains(*bb_it)) mark_live(LLVMGetBasicBlockTerminator(*bb_it), live, worklist);
+
+        for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = LLVMGetNextInstruction(i)) {
+            op = LLVMGetInstructionOpcode(i);
+            if (op == LLVMRet || op == LLVMCall) mark_live(i, live, worklist);
+            else if (op == LLVMStore && !LLVMIsAAllocaInst(LLVMGetOperand(i, 1))) mark_live(i, live, worklist);
+        }
+    }
+
+    // Propagate liveness through data and control dependences.
+    while (!worklist.empty()) {
+        i = worklist.back();
+        worklist.pop_back();
+        bb = LLVMGetInstructionParent(i);
+        op = LLVMGetInstructionOpcode(i);
+
+        // Operands of an unconditional branch are blocks, not values.
+        if (op != LLVMBr) {
+            for (k = 0; k < (unsigned int) LLVMGetNumOperands(i); k++) mark_live(LLVMGetOperand(i, k), live, worklist);
+        } else if (LLVMIsConditional(i)) mark_live(LLVMGetCondition(i), live, worklist);
+
+        // Each incoming edge of a live phi must survive.
+        if (op == LLVMPHI)
+            for (k = 0; k < LLVMCountIncoming(i); k++)
+                if (reachable.contains(LLVMGetIncomingBlock(i, k)))
+                    mark_live(LLVMGetBasicBlockTerminator(LLVMGetIncomingBlock(i, k)), live, worklist);
+
+        // A live load needs every store that may have written its location.
+        if (op == LLVMLoad && LLVMIsAAllocaInst(LLVMGetOperand(i, 0)))
+            for (use = LLVMGetFirstUse(LLVMGetOperand(i, 0)); use != NULL; use = LLVMGetNextUse(use)) {
+                v = LLVMGetUser(use);
+                if (LLVMGetInstructionOpcode(v) == LLVMStore && LLVMGetOperand(v, 1) == LLVMGetOperand(i, 0) && reachable.contains(LLVMGetInstructionParent(v)))
+                    mark_live(v, live, worklist);
+            }
+
+        // A block that does something needs the branches deciding whether it runs.
+        if (!reachable.contains(bb) || live_blocks.contains(bb)) continue;
+        live_blocks.insert(bb);
+        if (!pdf.contains(bb)) continue;
+        for (pdf_it = pdf.at(bb).begin(); pdf_it != pdf.at(bb).end(); ++pdf_it)
+            mark_live(LLVMGetBasicBlockTerminator(*pdf_it), live, worklist);
+    }
+
+    // Sweep: collect dead non-terminators and dead conditional branches.
+    for (bb_it = rpo.begin(); bb_it != rpo.end(); ++bb_it) {
+        for (i = LLVMGetFirstInstruction(*bb_it); i != NULL; i = LLVMGetNextInstruction(i)) {
+            if (live.contains(i)) continue;
+
+            if (!LLVMIsATerminatorInst(i)) dead.push_back(i);
+            else if (LLVMGetInstructionOpcode(i) == LLVMBr && LLVMIsConditional(i) && ipdom.at(*bb_it) != NULL) branches.push_back(i);
+        }
+    }
+
+    if (dead.empty() && branches.empty()) return false;
+
+    // Dead values are used only by dead instructions or unreachable code, so undef is a safe stand-in.
+    for (instr_it = dead.begin(); instr_it != dead.end(); ++instr_it) {
+        record("adce.removed", *instr_it);
+        if (LLVMGetTypeKind(LLVMTypeOf(*instr_it)) != LLVMVoidTypeKind) LLVMReplaceAllUsesWith(*instr_it, LLVMGetUndef(LLVMTypeOf(*instr_it)));
+    }
+    for (instr_it = dead.begin(); instr_it != dead.end(); ++instr_it) LLVMInstructionEraseFromParent(*instr_it);
+
+    // Skip straight to the immediate post-dominator: every path from the branch reaches it with no live work on the way.
+    b = LLVMCreateBuilder();
+    for (instr_it = branches.begin(); instr_it != branches.end(); ++instr_it) {
+        term = *instr_it;
+        bb = LLVMGetInstructionParent(term);
+        target = ipdom.at(bb);
+        succs = get_successors(bb);
+
+        record("adce.branches_removed", term);
+        LLVMPositionBuilderBefore(b, term);
+        LLVMBuildBr(b, target);
+        LLVMInstructionEraseFromParent(term);
+
+        for (succ_it = succs.begin(); succ_it != succs.end(); ++succ_it)
+            if (*succ_it != target && std::find(succs.begin(), succ_it, *succ_it) == succ_it) remove_phi_incoming(*succ_it, bb);
+    }
+    LLVMDisposeBuilder(b);
+
+    if (branches.empty()) {
+        am.invalidate(f, PRESERVE_CFG);
+        return true;
+    }
+
+    // The skipped blocks are now unreachable.
+    am.invalidate(f, PRESERVE_NONE);
+    simplify_cfg(f);
+
+    return true;
+}
@@ -10,6 +10,19 @@
  * - constant folding
  * - constants propagation
  * - live variable analysis
+ * - memory to register promotion
+ * - global value numbering
+ * - loop-invariant code motion
+ * - induction variable strength reduction
+ * - closed forms of counting loops
+ * - sparse conditional constant propagation
+ * - control-flow graph simplification
+ * - instruction combining
+ * - dead store and dead alloca elimination
+ * - aggressive dead code elimination
+ * - a pass registry with configurable pipelines, -O levels, per-pass switches and an iteration cap
+ * - time and fuel budgets that stop optimization early with a valid module
+ * - statistics for every pass and an optional YAML remarks file of each transformation
  *
  * Citations:
  * - ChatGPT for help with move assignment (to avoid segfault in main)
@@ -17,9 +30,15 @@
 
 #pragma once
 #include <llvm-c/Core.h>
+#include <chrono>
+#include <map>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
+#include <vector>
+#include "bitvector.h"
+#include "analysis_manager.h"
 
 class Optimizer {
 public:
@@ -33,12 +52,68 @@ public:
 
     int optimize(void);
 
+    bool set_pipeline(const std::string& passes);
+    bool set_opt_level(int level);
+    bool set_pass_enabled(const std::string& name, bool enabled);
+    void set_max_iterations(size_t n);
+    void set_time_budget(double ms);
+    void set_fuel(size_t fuel);
+    bool budget_exhausted(void) const;
+    const std::map<std::string, size_t>& get_skipped_passes(void) const;
+
     LLVMModuleRef get_module_ref(void) const;
+    size_t get_dataflow_visits(void) const;
+    size_t get_analysis_reuses(void) const;
+    const std::map<std::string, size_t>& get_statistics(void) const;
+    size_t get_statistic(const std::string& name) const;
+    void enable_remarks(bool enabled);
+    bool write_remarks(const std::string& fname) const;
     void print_module(void) const;
 
 private:
+    /*
+     * Registry entry for a pass: exactly one of block_pass and function_pass is set.
+     * Local passes only revisit dirty blocks; constant propagation reruns only after a stored value changed.
+     */
+    struct PassInfo {
+        const char* name;
+        bool (Optimizer::*block_pass)(LLVMBasicBlockRef);
+        bool (Optimizer::*function_pass)(LLVMValueRef);
+        bool on_store_change;
+    };
+
+    /*
+     * One transformation: the statistic it counts towards and where it happened, as printed before the change.
+     */
+    struct Remark {
+        std::string statistic;
+        std::string function;
+        std::string block;
+        std::string instruction;
+    };
+
+    static const PassInfo pass_registry[];
+    static const size_t num_passes;
+
     // Instance variables.
     LLVMModuleRef m;
+    AnalysisManager am;
+    std::map<std::string, size_t> stats;
+    bool remarks_enabled;
+    std::vector<Remark> remarks;
+    std::unordered_set<LLVMBasicBlockRef> dirty_blocks;
+    bool stores_dirty;
+    std::vector<std::vector<size_t>> pipeline;
+    std::vector<bool> pass_enabled;
+    size_t max_iterations;
+    std::unordered_map<LLVMValueRef, int> unassigned;
+    double time_budget_ms;
+    size_t fuel;
+    size_t fuel_used;
+    size_t dataflow_visits_start;
+    std::chrono::steady_clock::time_point deadline;
+    bool exhausted;
+    std::map<std::string, size_t> skipped_passes;
 
     bool common_sub_expr_elim(LLVMBasicBlockRef bb);
 
@@ -50,5 +125,39 @@ private:
 
     int live_variable_analysis(LLVMValueRef f);
 
-    void print_set(std::unordered_map<LLVMBasicBlockRef, std::set<LLVMValueRef>>& print_set);
+    bool mem_to_reg(LLVMValueRef f);
+
+    bool global_value_numbering(LLVMValueRef f);
+
+    bool loop_invariant_code_motion(LLVMValueRef f);
+
+    bool strength_reduction(LLVMValueRef f);
+
+    bool scalar_evolution(LLVMValueRef f);
+
+    bool sparse_conditional_constant_propagation(LLVMValueRef f);
+
+    bool simplify_cfg(LLVMValueRef f);
+
+    bool instruction_combining(LLVMValueRef f);
+
+    bool dead_store_elimination(LLVMValueRef f);
+
+    bool aggressive_dead_code_elim(LLVMValueRef f);
+
+    bool run_live_variable_analysis(LLVMValueRef f);
+
+    bool run_stage(LLVMValueRef f, const std::vector<size_t>& stage);
+
+    bool consume_budget(size_t pass, size_t cost);
+
+    void record(const std::string& statistic, LLVMValueRef v);
+
+    void mark_users_dirty(LLVMValueRef v);
+
+    void mark_operands_dirty(LLVMValueRef i);
+
+    void mark_function_dirty(LLVMValueRef f);
+
+    void print_set(std::vector<BitVector>& print_set, std::vector<LLVMValueRef>& instrs);
 };